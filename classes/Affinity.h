@@ -0,0 +1,126 @@
+// header for thread pinning and NUMA topology
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// NUMA node structure (node id and the cpus that belong to it)
+struct NumaNode
+{
+    int id;
+    std::vector<int> cpus;
+};
+
+// parse a cpu list as written by the kernel, e.g. "0-15,32-47"
+std::vector<int> parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream s(list);
+    std::string range;
+
+    while (std::getline(s, range, ','))
+    {
+        if (range.empty() || range == "\n")
+            continue;
+
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// cpus the process is allowed to run on (honours taskset / cgroup limits)
+std::vector<int> allowedCpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty())
+    {
+        int count = std::max(1u, std::thread::hardware_concurrency());
+        for (int cpu = 0; cpu < count; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// detect NUMA nodes from sysfs, falls back to a single node holding every allowed cpu
+std::vector<NumaNode> detectNumaNodes()
+{
+    std::vector<int> allowed = allowedCpus();
+    std::vector<NumaNode> nodes;
+
+    for (int id = 0;; ++id)
+    {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+        if (!in)
+            break;
+
+        std::string list;
+        std::getline(in, list);
+
+        // keep only the cpus this process may use
+        NumaNode node;
+        node.id = id;
+        for (int cpu : parseCpuList(list))
+        {
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                node.cpus.push_back(cpu);
+        }
+        if (!node.cpus.empty())
+            nodes.push_back(node);
+    }
+
+    if (nodes.empty())
+    {
+        NumaNode node;
+        node.id = 0;
+        node.cpus = allowed;
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+// pin the calling thread to the given cpus (one cpu pins it to a core, a node's list keeps it on the node)
+bool pinCurrentThread(const std::vector<int> &cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+#endif
@@ -0,0 +1,192 @@
+// header for the process-wide asset cache (parsed meshes and the texture registry)
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include <sys/stat.h>
+
+#include "Model.h"
+#include "Texture.h"
+
+// modification time of a file in nanoseconds (-1 if it cannot be read)
+int64_t fileModificationTime(const std::string &path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return -1;
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+// asset cache class: every file is loaded once per process, even when several
+// scenes are parsed at the same time (later callers wait for the first load)
+class AssetCache
+{
+public:
+    AssetCache() : texturesDecoded(0), residentTextureBytes(0), peakResidentTextureBytes(0), textureTickets(0) {}
+
+    AssetCache(const AssetCache &) = delete;
+    AssetCache &operator=(const AssetCache &) = delete;
+
+    // mesh geometry (parsed OBJ or mapped mesh file), shared by every model using the file.
+    // A file modified since it was cached is loaded again; models built on the old geometry
+    // keep it alive until they go away.
+    MeshArrays mesh(const std::string &path)
+    {
+        return load(meshes, path, fileModificationTime(path), [&path]()
+                    { return loadMesh(path); });
+    }
+
+    // decoded texture, shared by every material that uses the file. The registry only keeps a
+    // weak reference: the texels are freed once the last scene holding a handle lets go (and
+    // decoded again if a later scene needs them). Like meshes, a modified file is reloaded.
+    std::shared_ptr<Texture> texture(const std::string &path)
+    {
+        const int64_t version = fileModificationTime(path);
+        std::unique_lock<std::mutex> lock(mutex);
+        TextureEntry &entry = textures[path];
+        if (entry.version == version)
+        {
+            if (std::shared_ptr<Texture> texture = entry.texture.lock())
+                return texture;
+            if (entry.loading.valid())
+            {
+                std::shared_future<std::shared_ptr<Texture>> pending = entry.loading;
+                lock.unlock();
+                return pending.get();
+            }
+        }
+
+        // First user (of this version of the file): decode outside the lock
+        std::promise<std::shared_ptr<Texture>> promise;
+        const uint64_t ticket = ++textureTickets;
+        entry.version = version;
+        entry.ticket = ticket;
+        entry.texture.reset();
+        entry.loading = promise.get_future().share();
+        lock.unlock();
+
+        std::shared_ptr<Texture> texture(new Texture(path), [this](Texture *texture)
+                                         { release(texture); });
+
+        lock.lock();
+        texturesDecoded++;
+        residentTextureBytes += texture->bytes();
+        peakResidentTextureBytes = std::max(peakResidentTextureBytes, residentTextureBytes);
+        TextureEntry &current = textures[path];
+        if (current.ticket == ticket)
+        {
+            current.texture = texture;
+            current.loading = std::shared_future<std::shared_ptr<Texture>>();
+        }
+        lock.unlock();
+        promise.set_value(texture);
+        return texture;
+    }
+
+    size_t meshCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return meshes.size();
+    }
+
+    // textures decoded so far (a texture freed and needed again counts twice)
+    size_t textureCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return texturesDecoded;
+    }
+
+    // texel memory of the textures alive right now, and the most there ever was at once
+    size_t textureBytes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return residentTextureBytes;
+    }
+
+    size_t peakTextureBytes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peakResidentTextureBytes;
+    }
+
+private:
+    // cached asset with the version of the file it was loaded from
+    template <typename T>
+    struct Entry
+    {
+        int64_t version;
+        std::shared_future<T> value;
+    };
+
+    // registered texture: alive while any handle is, or still being decoded (loading valid)
+    struct TextureEntry
+    {
+        int64_t version;
+        uint64_t ticket;
+        std::weak_ptr<Texture> texture;
+        std::shared_future<std::shared_ptr<Texture>> loading;
+
+        TextureEntry() : version(-2), ticket(0) {}
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Entry<MeshArrays>> meshes;
+    std::map<std::string, TextureEntry> textures;
+    size_t texturesDecoded;
+    size_t residentTextureBytes;
+    size_t peakResidentTextureBytes;
+    uint64_t textureTickets;
+
+    // deleter of the texture handles: forget the texture unless a newer one took its place
+    void release(Texture *texture)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            residentTextureBytes -= texture->bytes();
+            auto it = textures.find(texture->filename);
+            if (it != textures.end() && it->second.texture.expired() && !it->second.loading.valid())
+                textures.erase(it);
+        }
+        delete texture;
+    }
+
+    // look the asset up and load it outside the lock if this caller is the first (for this
+    // version of the file)
+    template <typename T, typename Loader>
+    T load(std::map<std::string, Entry<T>> &entries, const std::string &path, int64_t version, Loader loader)
+    {
+        std::promise<T> promise;
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = entries.find(path);
+        if (it != entries.end() && it->second.version == version)
+        {
+            std::shared_future<T> pending = it->second.value;
+            lock.unlock();
+            return pending.get();
+        }
+        Entry<T> &entry = entries[path];
+        entry.version = version;
+        entry.value = promise.get_future().share();
+        lock.unlock();
+
+        T value = loader();
+        promise.set_value(value);
+        return value;
+    }
+};
+
+// the process-wide cache
+AssetCache &assetCache()
+{
+    static AssetCache cache;
+    return cache;
+}
+
+#endif
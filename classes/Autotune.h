@@ -0,0 +1,168 @@
+// header for the render autotuner (probe renders, per scene and host cache)
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include <unistd.h>
+
+#include "render.h"
+
+// tune config structure (one probed render configuration and its throughput)
+struct TuneConfig
+{
+    int threads;
+    int tileSize;
+    bool pinThreads;
+    bool numaLocal;
+    double raysPerSecond;
+};
+
+// name of this machine (the cache keeps one entry per scene and host)
+std::string hostName()
+{
+    char name[256] = {0};
+    if (gethostname(name, sizeof(name) - 1) != 0)
+        return "unknown";
+    return name;
+}
+
+// look up a cached config for the scene on this host
+bool loadTuneConfig(const std::string &cachePath, uint64_t sceneHash, TuneConfig &config)
+{
+    std::ifstream in(cachePath);
+    std::string line;
+    std::string host = hostName();
+
+    while (std::getline(in, line))
+    {
+        std::istringstream s(line);
+        std::string lineHost;
+        uint64_t lineHash;
+        TuneConfig entry;
+        if (s >> lineHost >> std::hex >> lineHash >> std::dec >> entry.threads >> entry.tileSize >> entry.pinThreads >> entry.numaLocal >> entry.raysPerSecond)
+        {
+            if (lineHost == host && lineHash == sceneHash)
+            {
+                config = entry;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// store the config for the scene on this host, replacing an older entry
+void saveTuneConfig(const std::string &cachePath, uint64_t sceneHash, const TuneConfig &config)
+{
+    std::string host = hostName();
+    std::vector<std::string> lines;
+
+    std::ifstream in(cachePath);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream s(line);
+        std::string lineHost;
+        uint64_t lineHash;
+        if (s >> lineHost >> std::hex >> lineHash && lineHost == host && lineHash == sceneHash)
+            continue;
+        lines.push_back(line);
+    }
+    in.close();
+
+    std::ostringstream entry;
+    entry << host << " " << std::hex << sceneHash << std::dec << " " << config.threads << " " << config.tileSize << " "
+          << config.pinThreads << " " << config.numaLocal << " " << config.raysPerSecond;
+    lines.push_back(entry.str());
+
+    std::ofstream out(cachePath);
+    for (const std::string &l : lines)
+        out << l << "\n";
+}
+
+// probe blocks: an evenly spread sample of the frame's maxTile x maxTile blocks (at most count).
+// Every candidate tile size divides maxTile, so each candidate renders exactly these pixels.
+std::vector<char> probeBlocks(const Camera &camera, int maxTile, int count, int &blocksX)
+{
+    blocksX = (camera.imgWidth + maxTile - 1) / maxTile;
+    int blocks = blocksX * ((camera.imgHeight + maxTile - 1) / maxTile);
+    count = std::min(count, blocks);
+
+    std::vector<char> chosen(blocks, 0);
+    for (int k = 0; k < count; ++k)
+        chosen[static_cast<size_t>(k) * blocks / count] = 1;
+    return chosen;
+}
+
+// time one candidate on the probe blocks (full resolution, the same pixels for every candidate)
+TuneConfig probeConfig(const Scene &scene, const Camera &camera, const std::vector<char> &blocks, int blocksX, int maxTile,
+                       int threads, int tileSize, bool pinThreads, bool numaLocal)
+{
+    RenderOptions options;
+    options.threads = threads;
+    options.tileSize = tileSize;
+    options.pinThreads = pinThreads;
+    options.numaLocal = numaLocal;
+
+    std::vector<Tile> tiles = makeTiles(camera.imgWidth, camera.imgHeight, tileSize);
+    options.tileMask.assign(tiles.size(), 0);
+    for (size_t i = 0; i < tiles.size(); ++i)
+        options.tileMask[i] = blocks[(tiles[i].y0 / maxTile) * blocksX + tiles[i].x0 / maxTile];
+
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<RenderJob> job = renderAsync(scene, camera, options);
+    job->result().wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    TuneConfig config = {threads, tileSize, pinThreads, numaLocal, job->stats().rays() / seconds};
+    std::cout << "Probe: threads=" << threads << ", tile=" << tileSize << ", pin=" << pinThreads
+              << ", numa=" << numaLocal << " -> " << config.raysPerSecond / 1e6 << " Mrays/s" << std::endl;
+    return config;
+}
+
+// render the same sample of full-size 64x64 blocks of the frame (tilesPerThread blocks per
+// thread at the largest thread count) with candidate configurations and return the one with
+// the highest ray throughput. The tile size is picked first, then the thread count,
+// then the placement, so it takes 6-8 probes instead of every combination.
+TuneConfig autotune(const Scene &scene, const Camera &camera, int tilesPerThread = 2)
+{
+    int cores = static_cast<int>(allowedCpus().size());
+    std::vector<int> threadCounts;
+    threadCounts.push_back(cores);
+    if (cores > 1)
+        threadCounts.push_back(cores / 2);
+    threadCounts.push_back(cores * 2);
+
+    const int tileSizes[] = {8, 16, 32, 64};
+    const int maxTile = 64;
+    bool multiNode = detectNumaNodes().size() > 1;
+
+    int blocksX;
+    std::vector<char> blocks = probeBlocks(camera, maxTile, tilesPerThread * cores * 2, blocksX);
+
+    TuneConfig best = {numThreads, defaultTileSize, false, false, 0.0};
+    auto consider = [&](int threads, int tileSize, bool pinThreads, bool numaLocal)
+    {
+        TuneConfig config = probeConfig(scene, camera, blocks, blocksX, maxTile, threads, tileSize, pinThreads, numaLocal);
+        if (config.raysPerSecond > best.raysPerSecond)
+            best = config;
+    };
+
+    for (int tileSize : tileSizes)
+        consider(cores, tileSize, false, false);
+    for (size_t t = 1; t < threadCounts.size(); ++t)
+        consider(threadCounts[t], best.tileSize, false, false);
+    consider(best.threads, best.tileSize, true, false);
+    if (multiNode)
+        consider(best.threads, best.tileSize, false, true);
+    return best;
+}
+
+#endif
@@ -23,6 +23,8 @@ public:
     Matrix4 transform;
     bool isTransform;
     bool dof;
+    // crop window as fractions of the image, from the top left (0 0 1 1 = the whole image)
+    double cropLeft, cropTop, cropRight, cropBottom;
 
     // Constructor
     Camera()
@@ -38,6 +40,8 @@ public:
         maxBounce = 5;
         isTransform = false;
         dof = false;
+        cropLeft = cropTop = 0;
+        cropRight = cropBottom = 1;
     }
 
     //  Constructor with parameters
@@ -54,6 +58,8 @@ public:
         this->maxBounce = maxBounce;
         this->isTransform = isTransform;
         this->dof = dof;
+        cropLeft = cropTop = 0;
+        cropRight = cropBottom = 1;
     }
 
     // Generate ray function
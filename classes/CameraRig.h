@@ -0,0 +1,94 @@
+// header for camera rigs (sets of views rendered together by renderViews())
+#ifndef CAMERARIG_H
+#define CAMERARIG_H
+
+#include <vector>
+#include <cmath>
+
+#include "Camera.h"
+#include "Matrix4.h"
+
+// move a camera by an offset given in its own frame (x right, y up)
+Camera offsetCamera(const Camera &camera, double dx, double dy)
+{
+    Camera moved = camera;
+    if (camera.isTransform)
+    {
+        // the transform maps camera space to the world, so translate in camera space
+        moved.transform = camera.transform * Matrix4::translate(dx, dy, 0.0);
+    }
+    else
+    {
+        Vector3 forward = (camera.lookAt - camera.position).normalized();
+        Vector3 right = forward.cross(camera.up).normalized();
+        Vector3 up = right.cross(forward).normalized();
+        Vector3 offset = right * dx + up * dy;
+        moved.position = camera.position + offset;
+        moved.lookAt = camera.lookAt + offset;
+    }
+    return moved;
+}
+
+// stereo pair with parallel axes: left eye, right eye
+std::vector<Camera> stereoCameras(const Camera &camera, double eyeSeparation)
+{
+    std::vector<Camera> views;
+    views.push_back(offsetCamera(camera, -eyeSeparation / 2.0, 0.0));
+    views.push_back(offsetCamera(camera, eyeSeparation / 2.0, 0.0));
+    return views;
+}
+
+// six square 90 degree views from the camera position in the order +X, -X, +Y, -Y, +Z, -Z
+// (world axes, or camera space axes when the camera uses its transform)
+std::vector<Camera> cubeMapCameras(const Camera &camera)
+{
+    const Vector3 directions[6] = {Vector3(1, 0, 0), Vector3(-1, 0, 0), Vector3(0, 1, 0),
+                                   Vector3(0, -1, 0), Vector3(0, 0, 1), Vector3(0, 0, -1)};
+    const Vector3 ups[6] = {Vector3(0, 1, 0), Vector3(0, 1, 0), Vector3(0, 0, -1),
+                            Vector3(0, 0, 1), Vector3(0, 1, 0), Vector3(0, 1, 0)};
+
+    std::vector<Camera> views;
+    for (int face = 0; face < 6; ++face)
+    {
+        Camera view = camera;
+        view.imgHeight = view.imgWidth;
+
+        // generateRay() takes tan(fov / 2) with depth of field and tan(fov) without,
+        // a 90 degree face needs that to be 1
+        view.fov = camera.dof ? M_PI / 2.0 : M_PI / 4.0;
+
+        if (camera.isTransform)
+        {
+            Vector3 right = directions[face].cross(ups[face]).normalized();
+            Matrix4 rotation;
+            rotation.makeRotationFromBasis(right, ups[face], directions[face]);
+            view.transform = camera.transform * rotation;
+        }
+        else
+        {
+            view.lookAt = camera.position + directions[face];
+            view.up = ups[face];
+        }
+        views.push_back(view);
+    }
+    return views;
+}
+
+// columns x rows grid of parallel cameras `spacing` apart, centered on the camera,
+// row by row from the top left (a light field array)
+std::vector<Camera> cameraArray(const Camera &camera, int columns, int rows, double spacing)
+{
+    std::vector<Camera> views;
+    for (int r = 0; r < rows; ++r)
+    {
+        for (int c = 0; c < columns; ++c)
+        {
+            double dx = (c - (columns - 1) / 2.0) * spacing;
+            double dy = ((rows - 1) / 2.0 - r) * spacing;
+            views.push_back(offsetCamera(camera, dx, dy));
+        }
+    }
+    return views;
+}
+
+#endif
@@ -0,0 +1,229 @@
+// header for render checkpoints (periodic save of finished tiles, resume after a kill)
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+
+#include "Framebuffer.h"
+#include "TileQueue.h"
+
+// checkpoint header structure (the file must match the frame being resumed)
+struct CheckpointHeader
+{
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t tileSize;
+    uint32_t reserved;
+    uint64_t sceneHash;
+};
+
+// checkpoint record structure (followed by the tile's pixels as float RGB, row by row)
+struct CheckpointRecord
+{
+    int32_t index;
+    // samples per pixel accumulated in the stored values (progressive modes keep adding to it)
+    uint32_t samples;
+};
+
+CheckpointHeader makeCheckpointHeader(int width, int height, int tileSize, uint64_t sceneHash)
+{
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "RTCK", 4);
+    header.version = 1;
+    header.width = width;
+    header.height = height;
+    header.tileSize = tileSize;
+    header.sceneHash = sceneHash;
+    return header;
+}
+
+// load a checkpoint into the image and mark its tiles as done; a record cut short by a
+// kill in the middle of a write is ignored. Returns false if the file does not match.
+bool loadCheckpoint(const std::string &path, const CheckpointHeader &expected, const std::vector<Tile> &tiles,
+                    Framebuffer &image, std::vector<char> &done, std::vector<uint32_t> &samples)
+{
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    CheckpointHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(&header, &expected, sizeof(header)) != 0)
+    {
+        std::fclose(file);
+        return false;
+    }
+
+    done.assign(tiles.size(), 0);
+    samples.assign(tiles.size(), 0);
+    std::vector<Vector3> pixels;
+
+    long validEnd = std::ftell(file);
+    CheckpointRecord record;
+    while (std::fread(&record, sizeof(record), 1, file) == 1)
+    {
+        if (record.index < 0 || record.index >= static_cast<int32_t>(tiles.size()))
+            break;
+
+        const Tile &tile = tiles[record.index];
+        int tileWidth = tile.x1 - tile.x0;
+        pixels.resize(static_cast<size_t>(tileWidth) * (tile.y1 - tile.y0));
+        if (std::fread(pixels.data(), sizeof(Vector3), pixels.size(), file) != pixels.size())
+            break;
+
+        for (int j = tile.y0; j < tile.y1; ++j)
+        {
+            std::copy(&pixels[(j - tile.y0) * tileWidth], &pixels[(j - tile.y0) * tileWidth] + tileWidth, &image.at(tile.x0, j));
+        }
+        done[record.index] = 1;
+        samples[record.index] = record.samples;
+        validEnd = std::ftell(file);
+    }
+    std::fclose(file);
+
+    // drop a torn record at the end so new records append cleanly
+    if (truncate(path.c_str(), validEnd) != 0)
+        return false;
+    return true;
+}
+
+// checkpoint writer class: render threads hand over finished tiles, a background thread
+// appends them to the file every interval and syncs it to disk
+class CheckpointWriter
+{
+public:
+    // resume = true appends to a checkpoint that loadCheckpoint() accepted
+    CheckpointWriter(const std::string &path, const CheckpointHeader &header, bool resume, int intervalSeconds)
+        : file(nullptr), interval(std::max(1, intervalSeconds)), stopped(false)
+    {
+        file = std::fopen(path.c_str(), resume ? "ab" : "wb");
+        if (!file)
+        {
+            std::cerr << "Cannot write checkpoint " << path << std::endl;
+            return;
+        }
+        if (!resume)
+        {
+            std::fwrite(&header, sizeof(header), 1, file);
+            sync();
+        }
+        writer = std::thread([this]()
+                             { run(); });
+    }
+
+    ~CheckpointWriter()
+    {
+        stop();
+    }
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // false if the file could not be opened (nothing would ever be saved)
+    bool isOpen() const
+    {
+        return file != nullptr;
+    }
+
+    // queue a finished tile (called from the render threads)
+    void add(size_t index, const Tile &tile, const Framebuffer &image, uint32_t samples)
+    {
+        if (!file)
+            return;
+        Pending entry;
+        entry.record.index = static_cast<int32_t>(index);
+        entry.record.samples = samples;
+        for (int j = tile.y0; j < tile.y1; ++j)
+        {
+            entry.pixels.insert(entry.pixels.end(), &image.at(tile.x0, j), &image.at(tile.x0, j) + (tile.x1 - tile.x0));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(entry));
+    }
+
+    // write whatever is queued and close the file
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        wake.notify_all();
+        if (writer.joinable())
+            writer.join();
+        if (file)
+        {
+            flush();
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+private:
+    // pending structure (a finished tile waiting for the next flush)
+    struct Pending
+    {
+        CheckpointRecord record;
+        std::vector<Vector3> pixels;
+    };
+
+    FILE *file;
+    std::chrono::seconds interval;
+    bool stopped;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Pending> pending;
+    std::thread writer;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, interval, [this]()
+                              { return stopped; }))
+        {
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    void flush()
+    {
+        std::vector<Pending> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batch.swap(pending);
+        }
+        if (batch.empty())
+            return;
+
+        for (const Pending &entry : batch)
+        {
+            std::fwrite(&entry.record, sizeof(entry.record), 1, file);
+            std::fwrite(entry.pixels.data(), sizeof(Vector3), entry.pixels.size(), file);
+        }
+        sync();
+    }
+
+    void sync()
+    {
+        std::fflush(file);
+        fsync(fileno(file));
+    }
+};
+
+#endif
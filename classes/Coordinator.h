@@ -0,0 +1,295 @@
+// header for multi-process tile rendering (coordinator and worker side)
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#include "Framebuffer.h"
+#include "TileQueue.h"
+
+// tile file header structure (followed by the tile's pixels as float RGB, row by row). sceneHash
+// identifies the render the tile belongs to (scene, image-changing flags and tiling), so tiles
+// left in a work directory by another render are never taken for this one's.
+struct TileFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sceneHash;
+    int32_t index;
+    int32_t x0, y0, x1, y1;
+};
+
+// path of the file holding one finished tile
+std::string tileFilePath(const std::string &dir, int index)
+{
+    return dir + "/tile_" + std::to_string(index) + ".bin";
+}
+
+// write a finished tile; the temporary file is renamed into place so a reader
+// (or a worker crashing half-way) never leaves a partial tile behind
+bool writeTileFile(const std::string &dir, int index, const Tile &tile, const Framebuffer &image, uint64_t sceneHash)
+{
+    std::string path = tileFilePath(dir, index);
+    std::string tmpPath = path + ".tmp" + std::to_string(getpid());
+
+    std::ofstream out(tmpPath, std::ios::binary);
+    if (!out)
+        return false;
+
+    TileFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "RTTL", 4);
+    header.version = 2;
+    header.sceneHash = sceneHash;
+    header.index = index;
+    header.x0 = tile.x0;
+    header.y0 = tile.y0;
+    header.x1 = tile.x1;
+    header.y1 = tile.y1;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (int j = tile.y0; j < tile.y1; ++j)
+    {
+        out.write(reinterpret_cast<const char *>(&image.at(tile.x0, j)), sizeof(Vector3) * (tile.x1 - tile.x0));
+    }
+    out.close();
+
+    if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// open a tile file and check its header against the tile of this render
+bool openTileFile(std::ifstream &in, const std::string &dir, int index, const Tile &tile, uint64_t sceneHash)
+{
+    in.open(tileFilePath(dir, index), std::ios::binary);
+    if (!in)
+        return false;
+
+    TileFileHeader header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    return in && std::memcmp(header.magic, "RTTL", 4) == 0 && header.version == 2 && header.sceneHash == sceneHash &&
+           header.index == index && header.x0 == tile.x0 && header.y0 == tile.y0 && header.x1 == tile.x1 && header.y1 == tile.y1;
+}
+
+// read a tile file into the image, false if it is missing or belongs to another render
+bool readTileFile(const std::string &dir, int index, const Tile &tile, Framebuffer &image, uint64_t sceneHash)
+{
+    std::ifstream in;
+    if (!openTileFile(in, dir, index, tile, sceneHash))
+        return false;
+
+    for (int j = tile.y0; j < tile.y1; ++j)
+    {
+        in.read(reinterpret_cast<char *>(&image.at(tile.x0, j)), sizeof(Vector3) * (tile.x1 - tile.x0));
+    }
+    return static_cast<bool>(in);
+}
+
+bool tileFileExists(const std::string &dir, int index)
+{
+    struct stat info;
+    return stat(tileFilePath(dir, index).c_str(), &info) == 0;
+}
+
+// true if the tile is already rendered (by this render, not one that used the directory before)
+bool tileFileValid(const std::string &dir, int index, const Tile &tile, uint64_t sceneHash)
+{
+    std::ifstream in;
+    return openTileFile(in, dir, index, tile, sceneHash);
+}
+
+// read the list of tile indices a worker was given
+std::vector<char> readTileList(const std::string &path, int tileCount)
+{
+    std::vector<char> mask(tileCount, 0);
+    std::ifstream in(path);
+    int index;
+    while (in >> index)
+    {
+        if (index >= 0 && index < tileCount)
+            mask[index] = 1;
+    }
+    return mask;
+}
+
+// coordinator options structure
+struct CoordinatorOptions
+{
+    int workers;
+    int maxAttempts;
+    std::string workDir;
+
+    // hash every tile file of this render carries (see TileFileHeader)
+    uint64_t sceneHash;
+
+    // command line every worker starts from (program, scene and render flags)
+    std::vector<std::string> workerCommand;
+
+    CoordinatorOptions() : workers(2), maxAttempts(3), sceneHash(0) {}
+};
+
+// start one worker process rendering the tiles listed in listPath
+pid_t spawnWorker(const CoordinatorOptions &options, const std::string &listPath)
+{
+    std::vector<std::string> args = options.workerCommand;
+    args.push_back("--worker");
+    args.push_back(options.workDir);
+    args.push_back("--worker-tiles");
+    args.push_back(listPath);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        std::vector<char *> argv;
+        for (auto &arg : args)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+
+        // argv[0] is only a path when the program was not started from PATH; the running
+        // binary itself is always at /proc/self/exe
+        execv("/proc/self/exe", argv.data());
+        execvp(argv[0], argv.data());
+        std::perror("execvp");
+        _exit(127);
+    }
+    return pid;
+}
+
+// split the image's tiles over worker processes, re-issue the tiles of workers that
+// crash, and merge every tile file into the image. Tiles of this render already present
+// in the work directory count as done, so workers started by hand on other machines
+// sharing the directory contribute as well; tiles of another render are deleted.
+// Returns false if some tile never got rendered.
+bool coordinateRender(const CoordinatorOptions &options, const std::vector<Tile> &tiles, Framebuffer &image)
+{
+    mkdir(options.workDir.c_str(), 0755);
+
+    const int tileCount = static_cast<int>(tiles.size());
+    int stale = 0;
+    for (int i = 0; i < tileCount; ++i)
+    {
+        if (tileFileExists(options.workDir, i) && !tileFileValid(options.workDir, i, tiles[i], options.sceneHash))
+        {
+            std::remove(tileFilePath(options.workDir, i).c_str());
+            stale++;
+        }
+    }
+    if (stale > 0)
+        std::cerr << "Removed " << stale << " tiles of another render from " << options.workDir << std::endl;
+
+    std::vector<int> attempts(tileCount, 0);
+    std::vector<char> inFlight(tileCount, 0);
+    std::map<pid_t, std::vector<int>> running;
+    std::vector<std::string> lists;
+    int batch = 0;
+
+    // hand the missing tiles out to at most `slots` new workers
+    auto issue = [&](int slots)
+    {
+        std::vector<int> pending;
+        for (int i = 0; i < tileCount; ++i)
+        {
+            if (!inFlight[i] && attempts[i] < options.maxAttempts && !tileFileValid(options.workDir, i, tiles[i], options.sceneHash))
+                pending.push_back(i);
+        }
+
+        for (int w = 0; w < slots && !pending.empty(); ++w)
+        {
+            // interleave the tiles so every worker gets a share of the cheap and the expensive ones
+            std::vector<int> share;
+            for (size_t k = w; k < pending.size(); k += slots)
+                share.push_back(pending[k]);
+            if (share.empty())
+                continue;
+
+            std::string listPath = options.workDir + "/worker_" + std::to_string(batch++) + ".tiles";
+            std::ofstream list(listPath);
+            for (int index : share)
+            {
+                list << index << "\n";
+                attempts[index]++;
+            }
+            list.close();
+            lists.push_back(listPath);
+
+            pid_t pid = spawnWorker(options, listPath);
+            if (pid > 0)
+            {
+                running[pid] = share;
+                for (int index : share)
+                    inFlight[index] = 1;
+            }
+            else
+            {
+                std::cerr << "Cannot start worker process" << std::endl;
+            }
+        }
+    };
+
+    issue(std::max(1, options.workers));
+
+    while (!running.empty())
+    {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+            break;
+
+        auto it = running.find(pid);
+        if (it == running.end())
+            continue;
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cerr << "Worker " << pid << " failed, re-issuing its unfinished tiles" << std::endl;
+        }
+        for (int index : it->second)
+            inFlight[index] = 0;
+        running.erase(it);
+
+        // refill the free slot with whatever is still missing
+        issue(std::max(1, options.workers) - static_cast<int>(running.size()));
+    }
+
+    // Merge the tiles into the image
+    bool complete = true;
+    for (int i = 0; i < tileCount; ++i)
+    {
+        if (!readTileFile(options.workDir, i, tiles[i], image, options.sceneHash))
+        {
+            std::cerr << "Tile " << i << " is missing" << std::endl;
+            complete = false;
+        }
+    }
+
+    // Clean up the work directory once the frame is whole
+    if (complete)
+    {
+        for (int i = 0; i < tileCount; ++i)
+            std::remove(tileFilePath(options.workDir, i).c_str());
+        for (auto &listPath : lists)
+            std::remove(listPath.c_str());
+        rmdir(options.workDir.c_str());
+    }
+    return complete;
+}
+
+#endif
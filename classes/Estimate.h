@@ -0,0 +1,128 @@
+// header for render cost estimation (sparse probe pass extrapolated to the full frame)
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include "render.h"
+
+// render estimate structure (extrapolated cost of a full render)
+struct RenderEstimate
+{
+    int width;
+    int height;
+    int threads;
+    int sampledPixels;
+    double probeSeconds;
+    double seconds;
+    uint64_t primaryRays;
+    uint64_t shadowRays;
+    uint64_t secondaryRays;
+    uint64_t framebufferBytes;
+    uint64_t sceneBytes;
+    uint64_t peakMemoryBytes;
+};
+
+// read a "VmRSS:  1234 kB" style line from /proc/self/status, in bytes
+uint64_t processMemory(const std::string &key)
+{
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.compare(0, key.size() + 1, key + ":") == 0)
+        {
+            std::istringstream s(line.substr(key.size() + 1));
+            uint64_t kilobytes = 0;
+            s >> kilobytes;
+            return kilobytes * 1024;
+        }
+    }
+    return 0;
+}
+
+// trace a stratified subsample of about `samples` pixels at full bounce depth on one
+// thread, then scale time and ray counts to the whole frame and the given thread count
+RenderEstimate estimateRender(const Scene &scene, const Camera &camera, int threads, int samples = 4096)
+{
+    RenderEstimate estimate;
+    estimate.width = camera.imgWidth;
+    estimate.height = camera.imgHeight;
+    estimate.threads = std::max(1, threads);
+
+    const double pixels = static_cast<double>(camera.imgWidth) * camera.imgHeight;
+    const int stride = std::max(1, static_cast<int>(std::sqrt(pixels / std::max(1, samples))));
+
+    RayCounts before = rayCounts;
+    auto start = std::chrono::steady_clock::now();
+
+    int sampled = 0;
+    for (int j = stride / 2; j < camera.imgHeight; j += stride)
+    {
+        for (int i = stride / 2; i < camera.imgWidth; i += stride)
+        {
+            renderPixel(scene, camera, i, j);
+            sampled++;
+        }
+    }
+
+    estimate.probeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    estimate.sampledPixels = sampled;
+
+    // Scale from the sampled pixels to the frame; threads beyond the core count add nothing
+    double scale = sampled > 0 ? pixels / sampled : 0.0;
+    int cores = static_cast<int>(allowedCpus().size());
+    estimate.seconds = estimate.probeSeconds * scale / std::min(estimate.threads, cores);
+    estimate.primaryRays = static_cast<uint64_t>((rayCounts.primary - before.primary) * scale);
+    estimate.shadowRays = static_cast<uint64_t>((rayCounts.shadow - before.shadow) * scale);
+    estimate.secondaryRays = static_cast<uint64_t>((rayCounts.secondary - before.secondary) * scale);
+
+    // Memory: what the loaded scene holds now plus the framebuffer and the per-thread counters
+    estimate.framebufferBytes = static_cast<uint64_t>(pixels) * sizeof(Vector3);
+    estimate.sceneBytes = processMemory("VmRSS");
+    estimate.peakMemoryBytes = std::max(processMemory("VmHWM"), estimate.sceneBytes) + estimate.framebufferBytes +
+                               static_cast<uint64_t>(estimate.threads) * sizeof(ThreadCounters);
+    return estimate;
+}
+
+// write the estimate as JSON
+void writeEstimateJson(std::ostream &out, const std::string &scenePath, const RenderEstimate &estimate)
+{
+    std::string escapedPath;
+    for (char c : scenePath)
+    {
+        if (c == '"' || c == '\\')
+            escapedPath += '\\';
+        escapedPath += c;
+    }
+
+    out << "{\n"
+        << "  \"scene\": \"" << escapedPath << "\",\n"
+        << "  \"width\": " << estimate.width << ",\n"
+        << "  \"height\": " << estimate.height << ",\n"
+        << "  \"threads\": " << estimate.threads << ",\n"
+        << "  \"samples_per_pixel\": " << samplesPerPixel << ",\n"
+        << "  \"sampled_pixels\": " << estimate.sampledPixels << ",\n"
+        << "  \"probe_seconds\": " << estimate.probeSeconds << ",\n"
+        << "  \"estimated_seconds\": " << estimate.seconds << ",\n"
+        << "  \"rays\": {\n"
+        << "    \"primary\": " << estimate.primaryRays << ",\n"
+        << "    \"shadow\": " << estimate.shadowRays << ",\n"
+        << "    \"secondary\": " << estimate.secondaryRays << ",\n"
+        << "    \"total\": " << estimate.primaryRays + estimate.shadowRays + estimate.secondaryRays << "\n"
+        << "  },\n"
+        << "  \"memory_bytes\": {\n"
+        << "    \"scene\": " << estimate.sceneBytes << ",\n"
+        << "    \"framebuffer\": " << estimate.framebufferBytes << ",\n"
+        << "    \"peak\": " << estimate.peakMemoryBytes << "\n"
+        << "  }\n"
+        << "}" << std::endl;
+}
+
+#endif
@@ -0,0 +1,235 @@
+// header for raw frame streaming (finished frames to stdout or a named pipe, e.g. an encoder)
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "Framebuffer.h"
+#include "ImageWriter.h"
+#include "ToneMap.h"
+
+// pixel format of a streamed frame
+enum class FrameFormat
+{
+    // 8-bit RGB, tone mapped and clamped like the PPM output
+    RGB8,
+    // linear float RGB (host byte order), unclamped like the PFM output
+    RGBF
+};
+
+// frame header structure (followed by payloadBytes of pixels, top row first)
+struct FrameHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t frame;
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    uint64_t payloadBytes;
+};
+
+// frame stream class: frames are handed over as they finish (in any order, from any thread)
+// and a dedicated I/O thread writes them in frame order while the next ones render. At most
+// `capacity` frames wait for the writer, further frames block in push() until it catches up.
+// Once a write fails, frames are dropped and failed() tells producers to stop.
+class FrameStream
+{
+public:
+    // path "-" is stdout; a named pipe blocks here until its reader opens it
+    FrameStream(const std::string &path, FrameFormat format, bool headers, const ToneMapSettings &toneMap, size_t capacity = 2)
+        : format(format), headers(headers), toneMap(toneMap), capacity(std::max<size_t>(1, capacity)), nextFrame(0), finishing(false), broken(false)
+    {
+        fd = path == "-" ? STDOUT_FILENO : ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "Cannot write " << path << std::endl;
+            broken = true;
+            return;
+        }
+        writer = std::thread([this]()
+                             { run(); });
+    }
+
+    ~FrameStream()
+    {
+        finish();
+    }
+
+    FrameStream(const FrameStream &) = delete;
+    FrameStream &operator=(const FrameStream &) = delete;
+
+    bool isOpen() const
+    {
+        return fd >= 0;
+    }
+
+    // true once the stream cannot be written (further frames are dropped)
+    bool failed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return broken;
+    }
+
+    // queue a finished frame; the image must not change afterwards. False if the stream
+    // failed and the frame was dropped.
+    bool push(uint32_t frame, const std::shared_ptr<const Framebuffer> &image)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // the frame the writer waits for always gets in, so out-of-order frames cannot deadlock
+        changed.wait(lock, [this, frame]()
+                     { return pending.size() < capacity || frame == nextFrame || broken; });
+        if (broken)
+            return false;
+        pending[frame] = image;
+        changed.notify_all();
+        return true;
+    }
+
+    // a frame that will never come (e.g. a scene that failed to load)
+    void skip(uint32_t frame)
+    {
+        push(frame, nullptr);
+    }
+
+    // write the queued frames and close the stream; false if a write failed
+    bool finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finishing = true;
+            changed.notify_all();
+        }
+        if (writer.joinable())
+            writer.join();
+        if (fd > STDOUT_FILENO)
+            ::close(fd);
+        fd = -1;
+        return !broken;
+    }
+
+private:
+    int fd;
+    FrameFormat format;
+    bool headers;
+    ToneMapSettings toneMap;
+    size_t capacity;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<uint32_t, std::shared_ptr<const Framebuffer>> pending;
+    uint32_t nextFrame;
+    bool finishing;
+    bool broken;
+    std::thread writer;
+
+    // I/O thread: write the frames in order; once finishing, gaps are skipped
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            changed.wait(lock, [this]()
+                         { return pending.count(nextFrame) || finishing || broken; });
+            if (broken || pending.empty())
+                break;
+
+            auto it = pending.count(nextFrame) ? pending.find(nextFrame) : pending.begin();
+            uint32_t frame = it->first;
+            std::shared_ptr<const Framebuffer> image = it->second;
+            pending.erase(it);
+            nextFrame = frame + 1;
+            changed.notify_all();
+
+            lock.unlock();
+            bool ok = !image || writeFrame(frame, *image);
+            lock.lock();
+            if (!ok)
+            {
+                std::cerr << "Frame stream closed, stopped at frame " << frame << std::endl;
+                broken = true;
+                pending.clear();
+                changed.notify_all();
+            }
+        }
+    }
+
+    bool writeFrame(uint32_t frame, const Framebuffer &linear)
+    {
+        const size_t pixelBytes = format == FrameFormat::RGB8 ? 3 : sizeof(Vector3);
+        const size_t rowBytes = static_cast<size_t>(linear.width) * pixelBytes;
+
+        if (headers)
+        {
+            FrameHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, "RTFR", 4);
+            header.version = 1;
+            header.frame = frame;
+            header.format = static_cast<uint32_t>(format);
+            header.width = linear.width;
+            header.height = linear.height;
+            header.payloadBytes = rowBytes * linear.height;
+            if (!writeAll(&header, sizeof(header)))
+                return false;
+        }
+
+        // Convert on this thread (not the render threads), a batch of rows per write
+        std::shared_ptr<Framebuffer> mapped;
+        if (format == FrameFormat::RGB8 && !toneMap.isIdentity())
+            mapped = ::toneMap(linear, toneMap);
+        const Framebuffer &image = mapped ? *mapped : linear;
+
+        const int rowsPerWrite = std::max<int>(1, static_cast<int>((size_t(1) << 20) / std::max<size_t>(1, rowBytes)));
+        std::vector<uint8_t> buffer(rowBytes * rowsPerWrite);
+        int buffered = 0;
+        for (int j = image.height - 1; j >= 0; --j)
+        {
+            uint8_t *out = &buffer[rowBytes * buffered];
+            if (format == FrameFormat::RGB8)
+                quantizeRow(&image.at(0, j), image.width, out);
+            else
+                std::memcpy(out, &image.at(0, j), rowBytes);
+
+            if (++buffered == rowsPerWrite || j == 0)
+            {
+                if (!writeAll(buffer.data(), rowBytes * buffered))
+                    return false;
+                buffered = 0;
+            }
+        }
+        return true;
+    }
+
+    // write() until everything is out (pipes take partial writes)
+    bool writeAll(const void *data, size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+// framebuffer header class
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <cstdlib>
+#include <new>
+
+#include "Vector3.h"
+
+class Framebuffer
+{
+public:
+    int width;
+    int height;
+    Vector3 *pixels;
+
+    // allocate the image; with deferTouch the pages stay untouched so the render threads
+    // can first-touch their own rows (the kernel then places them on the thread's NUMA node)
+    Framebuffer(int width, int height, bool deferTouch = false)
+        : width(width), height(height), pixels(nullptr), ownsPixels(true)
+    {
+        void *memory = nullptr;
+        if (posix_memalign(&memory, 64, sizeof(Vector3) * width * height) != 0)
+            throw std::bad_alloc();
+        pixels = static_cast<Vector3 *>(memory);
+
+        if (!deferTouch)
+            touchRows(0, height);
+    }
+
+    // wrap width x height pixels owned elsewhere (e.g. a shared memory segment), left as they are
+    Framebuffer(int width, int height, Vector3 *external)
+        : width(width), height(height), pixels(external), ownsPixels(false) {}
+
+    ~Framebuffer()
+    {
+        if (ownsPixels)
+            std::free(pixels);
+    }
+
+    Framebuffer(const Framebuffer &) = delete;
+    Framebuffer &operator=(const Framebuffer &) = delete;
+
+    Framebuffer(Framebuffer &&other)
+        : width(other.width), height(other.height), pixels(other.pixels), ownsPixels(other.ownsPixels)
+    {
+        other.pixels = nullptr;
+    }
+
+    // initialize rows [y0, y1) to black
+    void touchRows(int y0, int y1)
+    {
+        for (int j = y0; j < y1; ++j)
+        {
+            for (int i = 0; i < width; ++i)
+            {
+                new (&pixels[j * width + i]) Vector3();
+            }
+        }
+    }
+
+    Vector3 &at(int x, int y)
+    {
+        return pixels[y * width + x];
+    }
+
+    const Vector3 &at(int x, int y) const
+    {
+        return pixels[y * width + x];
+    }
+
+private:
+    bool ownsPixels;
+};
+
+#endif
@@ -0,0 +1,43 @@
+// header for the hash helpers (scene and configuration fingerprints)
+#ifndef HASH_H
+#define HASH_H
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+// FNV-1a hash over a byte range, chainable through the seed
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ULL)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t hashString(const std::string &text, uint64_t seed = 14695981039346656037ULL)
+{
+    return hashBytes(text.data(), text.size(), seed);
+}
+
+// hash of a file's contents (0 if it cannot be read)
+uint64_t hashFile(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return 0;
+
+    uint64_t hash = 14695981039346656037ULL;
+    char buffer[65536];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+    {
+        hash = hashBytes(buffer, static_cast<size_t>(in.gcount()), hash);
+    }
+    return hash;
+}
+
+#endif
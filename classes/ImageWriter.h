@@ -0,0 +1,301 @@
+// header for the image writers (and the PPM and PFM readers for compositing and tone mapping)
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+
+#include <zlib.h>
+
+#include "Framebuffer.h"
+
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be three packed floats");
+
+// quantize one framebuffer row to 8-bit RGB; values are clamped to [0, 1] (NaN gives 0) so
+// over-bright pixels saturate. A flat loop over the floats, which the compiler vectorizes.
+void quantizeRow(const Vector3 *row, int width, uint8_t *out)
+{
+    const float *in = &row[0].x;
+    const int count = width * 3;
+    for (int k = 0; k < count; ++k)
+    {
+        float v = std::max(0.0f, std::min(in[k], 1.0f));
+        // in double like writePPM(), so both give the same bytes
+        out[k] = static_cast<uint8_t>(v * 255.99);
+    }
+}
+
+// write the image as an ASCII PPM (P3), bottom row first
+bool writePPM(const Framebuffer &image, const std::string &path)
+{
+    std::ofstream ofs;
+    ofs.open(path);
+    if (!ofs)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    ofs << "P3\n"
+        << image.width << " " << image.height << "\n255\n";
+    std::vector<uint8_t> row(static_cast<size_t>(image.width) * 3);
+    for (int j = image.height - 1; j >= 0; --j)
+    {
+        // clamped like the binary writers (over-bright values used to wrap around)
+        quantizeRow(&image.at(0, j), image.width, row.data());
+        for (int i = 0; i < image.width; ++i)
+        {
+            ofs << int(row[i * 3]) << " " << int(row[i * 3 + 1]) << " " << int(row[i * 3 + 2]) << "\n";
+        }
+    }
+    ofs.close();
+    return true;
+}
+
+// write the image as a binary PPM (P6), top row first like writePPM()
+bool writeP6(const Framebuffer &image, const std::string &path)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    out << "P6\n"
+        << image.width << " " << image.height << "\n255\n";
+    std::vector<uint8_t> row(static_cast<size_t>(image.width) * 3);
+    for (int j = image.height - 1; j >= 0; --j)
+    {
+        quantizeRow(&image.at(0, j), image.width, row.data());
+        out.write(reinterpret_cast<const char *>(row.data()), row.size());
+    }
+    // close() flushes, so a full disk shows up here
+    out.close();
+    return static_cast<bool>(out);
+}
+
+bool hostIsLittleEndian()
+{
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+}
+
+// write the linear image as a PFM (float RGB in host byte order, bottom row first like the
+// framebuffer), nothing clamped: the input for compositing or a later tone mapping pass
+bool writePFM(const Framebuffer &image, const std::string &path)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    // a negative scale marks little-endian data
+    out << "PF\n"
+        << image.width << " " << image.height << (hostIsLittleEndian() ? "\n-1.0\n" : "\n1.0\n");
+    out.write(reinterpret_cast<const char *>(image.pixels), sizeof(Vector3) * image.width * image.height);
+    out.close();
+    return static_cast<bool>(out);
+}
+
+// PNG chunk: big-endian length, type, data and the CRC of type and data
+void writePNGChunk(std::ofstream &out, const char *type, const uint8_t *data, size_t size)
+{
+    uint8_t length[4] = {uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size)};
+    out.write(reinterpret_cast<const char *>(length), 4);
+    out.write(type, 4);
+    out.write(reinterpret_cast<const char *>(data), size);
+
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef *>(type), 4);
+    if (size > 0)
+        crc = crc32(crc, data, static_cast<uInt>(size));
+    uint8_t crcBytes[4] = {uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc)};
+    out.write(reinterpret_cast<const char *>(crcBytes), 4);
+}
+
+// write the image as an 8-bit RGB PNG; level is the zlib compression level (0 = stored,
+// 1 = fastest, 9 = smallest). Rows are deflated one at a time, there is no full-image copy.
+bool writePNG(const Framebuffer &image, const std::string &path, int level = 6)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.write(reinterpret_cast<const char *>(signature), 8);
+
+    // width, height, 8 bits, RGB, deflate, adaptive filtering, no interlace
+    uint8_t header[13] = {uint8_t(image.width >> 24), uint8_t(image.width >> 16), uint8_t(image.width >> 8), uint8_t(image.width),
+                          uint8_t(image.height >> 24), uint8_t(image.height >> 16), uint8_t(image.height >> 8), uint8_t(image.height),
+                          8, 2, 0, 0, 0};
+    writePNGChunk(out, "IHDR", header, sizeof(header));
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, std::max(0, std::min(level, 9))) != Z_OK)
+        return false;
+
+    const size_t rowBytes = static_cast<size_t>(image.width) * 3;
+    std::vector<uint8_t> row(rowBytes), filtered(rowBytes + 1);
+    std::vector<uint8_t> chunk(1 << 16);
+    stream.next_out = chunk.data();
+    stream.avail_out = static_cast<uInt>(chunk.size());
+
+    for (int j = image.height; j >= 0; --j)
+    {
+        // Sub filter (each byte minus the one of the pixel to its left), cheap and helps deflate
+        bool last = j == 0;
+        if (!last)
+        {
+            quantizeRow(&image.at(0, j - 1), image.width, row.data());
+            filtered[0] = 1;
+            for (size_t k = 0; k < rowBytes; ++k)
+                filtered[k + 1] = static_cast<uint8_t>(row[k] - (k >= 3 ? row[k - 3] : 0));
+            stream.next_in = filtered.data();
+            stream.avail_in = static_cast<uInt>(filtered.size());
+        }
+
+        // Compress the row (or finish the stream), emitting an IDAT chunk whenever the buffer fills
+        int status;
+        do
+        {
+            status = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+            if (stream.avail_out == 0 || (last && status == Z_STREAM_END))
+            {
+                writePNGChunk(out, "IDAT", chunk.data(), chunk.size() - stream.avail_out);
+                stream.next_out = chunk.data();
+                stream.avail_out = static_cast<uInt>(chunk.size());
+            }
+        } while (last ? status == Z_OK : stream.avail_in > 0);
+    }
+    deflateEnd(&stream);
+
+    writePNGChunk(out, "IEND", nullptr, 0);
+    out.close();
+    return static_cast<bool>(out);
+}
+
+// lower-case file extension with the dot ("" if there is none)
+std::string fileExtension(const std::string &path)
+{
+    std::string extension = path.substr(path.find_last_of('.') == std::string::npos ? path.size() : path.find_last_of('.'));
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+// write the image in the format given by the file extension: .png, .pfm (linear float),
+// otherwise binary PPM
+bool writeImage(const Framebuffer &image, const std::string &path, int pngLevel = 6)
+{
+    std::string extension = fileExtension(path);
+    if (extension == ".png")
+        return writePNG(image, path, pngLevel);
+    if (extension == ".pfm")
+        return writePFM(image, path);
+    return writeP6(image, path);
+}
+
+// read a PPM (P3 or P6) as written by writePPM() or writeP6(), nullptr if it cannot be read
+std::shared_ptr<Framebuffer> readPPM(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int width = 0, height = 0, maxValue = 0;
+
+    // skip "# comment" lines between the header fields
+    auto field = [&in](int &value)
+    {
+        in >> std::ws;
+        while (in.peek() == '#')
+        {
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            in >> std::ws;
+        }
+        return static_cast<bool>(in >> value);
+    };
+
+    if (!(in >> magic) || (magic != "P3" && magic != "P6") || !field(width) || !field(height) || !field(maxValue) || width <= 0 || height <= 0 ||
+        maxValue <= 0 || (magic == "P6" && maxValue > 255))
+    {
+        std::cerr << "Cannot read " << path << " (expected a PPM)" << std::endl;
+        return nullptr;
+    }
+    const bool binary = magic == "P6";
+    if (binary)
+        in.get();
+
+    std::shared_ptr<Framebuffer> image(new Framebuffer(width, height));
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+    for (int j = height - 1; j >= 0; --j)
+    {
+        if (binary && !in.read(reinterpret_cast<char *>(row.data()), row.size()))
+        {
+            std::cerr << "Cannot read " << path << " (truncated)" << std::endl;
+            return nullptr;
+        }
+        for (int i = 0; i < width; ++i)
+        {
+            int r, g, b;
+            if (binary)
+            {
+                r = row[i * 3];
+                g = row[i * 3 + 1];
+                b = row[i * 3 + 2];
+            }
+            else if (!(in >> r >> g >> b))
+            {
+                std::cerr << "Cannot read " << path << " (truncated)" << std::endl;
+                return nullptr;
+            }
+            image->at(i, j) = Vector3(r, g, b) / static_cast<float>(maxValue);
+        }
+    }
+    return image;
+}
+
+// read a color PFM as written by writePFM() (either byte order), nullptr if it cannot be read
+std::shared_ptr<Framebuffer> readPFM(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int width = 0, height = 0;
+    float scale = 0.0f;
+    if (!(in >> magic >> width >> height >> scale) || magic != "PF" || width <= 0 || height <= 0 || scale == 0.0f)
+    {
+        std::cerr << "Cannot read " << path << " (expected a color PFM)" << std::endl;
+        return nullptr;
+    }
+    in.get();
+
+    std::shared_ptr<Framebuffer> image(new Framebuffer(width, height));
+    const size_t count = static_cast<size_t>(width) * height * 3;
+    if (!in.read(reinterpret_cast<char *>(image->pixels), count * sizeof(float)))
+    {
+        std::cerr << "Cannot read " << path << " (truncated)" << std::endl;
+        return nullptr;
+    }
+
+    // a positive scale means big-endian floats
+    if ((scale < 0.0f) != hostIsLittleEndian())
+    {
+        uint8_t *bytes = reinterpret_cast<uint8_t *>(image->pixels);
+        for (size_t k = 0; k < count; ++k)
+            std::reverse(bytes + k * 4, bytes + k * 4 + 4);
+    }
+    return image;
+}
+
+#endif
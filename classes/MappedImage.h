@@ -0,0 +1,238 @@
+// header for images written straight into a memory-mapped file (out-of-core rendering)
+#ifndef MAPPEDIMAGE_H
+#define MAPPEDIMAGE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "Framebuffer.h"
+#include "TileQueue.h"
+#include "ImageWriter.h"
+
+// layout of a mapped image file
+enum class MappedLayout
+{
+    // binary PPM (P6), top row first: readable by any viewer, but a tile touches tileSize rows of the file
+    SCANLINES,
+    // TiledImageHeader, then one fixed-size RGB8 record per tile in makeTiles() order (each
+    // tile's rows from its top, edge tiles padded): a tile is one contiguous write
+    TILES
+};
+
+// tiled image header structure
+struct TiledImageHeader
+{
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t tileSize;
+    uint32_t reserved;
+};
+
+// mapped image class: the output file is sized up front and mapped shared, finished tiles are
+// quantized into their place in it. Every releaseBytes written the mapping's pages are dropped
+// from the process (the kernel writes them back from the page cache), so resident memory stays
+// bounded whatever the resolution.
+class MappedImage
+{
+public:
+    MappedImage(const std::string &path, int width, int height, int tileSize, MappedLayout layout, size_t releaseBytes = size_t(64) << 20)
+        : width(width), height(height), tileSize(tileSize), layout(layout), data(nullptr), size(0), headerSize(0),
+          releaseBytes(releaseBytes), written(0)
+    {
+        std::string header;
+        if (layout == MappedLayout::SCANLINES)
+        {
+            header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+            headerSize = header.size();
+            size = headerSize + size_t(width) * height * 3;
+        }
+        else
+        {
+            size_t tileCount = makeTiles(width, height, tileSize).size();
+            headerSize = sizeof(TiledImageHeader);
+            size = headerSize + tileCount * recordSize();
+        }
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            std::cerr << "Cannot write " << path << std::endl;
+            if (fd >= 0)
+                ::close(fd);
+            return;
+        }
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Cannot map " << path << std::endl;
+            return;
+        }
+        data = static_cast<uint8_t *>(mapping);
+
+        if (layout == MappedLayout::SCANLINES)
+        {
+            std::memcpy(data, header.data(), headerSize);
+        }
+        else
+        {
+            TiledImageHeader tiled;
+            std::memset(&tiled, 0, sizeof(tiled));
+            std::memcpy(tiled.magic, "RTTI", 4);
+            tiled.version = 1;
+            tiled.width = width;
+            tiled.height = height;
+            tiled.tileSize = tileSize;
+            std::memcpy(data, &tiled, sizeof(tiled));
+        }
+    }
+
+    ~MappedImage()
+    {
+        close();
+    }
+
+    MappedImage(const MappedImage &) = delete;
+    MappedImage &operator=(const MappedImage &) = delete;
+
+    bool isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    // quantize a finished tile (index as in makeTiles(), pixels at (x - x0, y - y0) of
+    // tilePixels as handed to RenderOptions::onTileBuffer); safe to call from every render thread
+    void writeTile(size_t index, const Tile &tile, const Framebuffer &tilePixels)
+    {
+        const int columns = tile.x1 - tile.x0;
+
+        // A tile clipped by a crop window still goes to its place in the whole tile's record:
+        // rows count from the top of the whole tile, columns from its left edge
+        const int tilesX = (width + tileSize - 1) / tileSize;
+        const int recordX0 = static_cast<int>(index % tilesX) * tileSize;
+        const int recordY1 = std::min(static_cast<int>(index / tilesX + 1) * tileSize, height);
+        for (int y = tile.y0; y < tile.y1; ++y)
+        {
+            uint8_t *out;
+            if (layout == MappedLayout::SCANLINES)
+                out = data + headerSize + (size_t(height - 1 - y) * width + tile.x0) * 3;
+            else
+                out = data + headerSize + index * recordSize() + (size_t(recordY1 - 1 - y) * tileSize + (tile.x0 - recordX0)) * 3;
+            quantizeRow(&tilePixels.pixels[(y - tile.y0) * tilePixels.width], columns, out);
+        }
+
+        // Drop the written pages once enough have piled up (one thread does it, the others carry on)
+        size_t bytes = size_t(columns) * (tile.y1 - tile.y0) * 3;
+        size_t before = written.fetch_add(bytes, std::memory_order_relaxed);
+        if (before / releaseBytes != (before + bytes) / releaseBytes && releaseMutex.try_lock())
+        {
+            release();
+            releaseMutex.unlock();
+        }
+    }
+
+    // flush the file and unmap it
+    bool close()
+    {
+        if (!data)
+            return false;
+        bool synced = msync(data, size, MS_SYNC) == 0;
+        munmap(data, size);
+        data = nullptr;
+        return synced;
+    }
+
+private:
+    int width;
+    int height;
+    int tileSize;
+    MappedLayout layout;
+    uint8_t *data;
+    size_t size;
+    size_t headerSize;
+    size_t releaseBytes;
+    std::atomic<size_t> written;
+    std::mutex releaseMutex;
+
+    size_t recordSize() const
+    {
+        return size_t(tileSize) * tileSize * 3;
+    }
+
+    // start the write-back and unmap the pages from the process; with a shared file mapping
+    // their contents stay in the page cache, a thread still writing there just faults them back in
+    void release()
+    {
+        msync(data, size, MS_ASYNC);
+        madvise(data, size, MADV_DONTNEED);
+    }
+};
+
+// convert a tiled image file to a binary PPM, one row of tiles in memory at a time
+bool convertTiledToP6(const std::string &inPath, const std::string &outPath)
+{
+    FILE *in = std::fopen(inPath.c_str(), "rb");
+    TiledImageHeader header;
+    if (!in || std::fread(&header, sizeof(header), 1, in) != 1 || std::memcmp(header.magic, "RTTI", 4) != 0 || header.version != 1 ||
+        header.width <= 0 || header.height <= 0 || header.tileSize <= 0)
+    {
+        std::cerr << "Cannot read " << inPath << " (expected a tiled image)" << std::endl;
+        if (in)
+            std::fclose(in);
+        return false;
+    }
+    FILE *out = std::fopen(outPath.c_str(), "wb");
+    if (!out)
+    {
+        std::cerr << "Cannot write " << outPath << std::endl;
+        std::fclose(in);
+        return false;
+    }
+
+    const int ts = header.tileSize;
+    const int tilesX = (header.width + ts - 1) / ts;
+    const int tilesY = (header.height + ts - 1) / ts;
+    const size_t recordSize = size_t(ts) * ts * 3;
+    std::fprintf(out, "P6\n%d %d\n255\n", header.width, header.height);
+
+    // The top row of tiles comes last in the file
+    std::vector<uint8_t> strip(recordSize * tilesX);
+    bool ok = true;
+    for (int ty = tilesY - 1; ty >= 0 && ok; --ty)
+    {
+        std::fseek(in, static_cast<long>(sizeof(header) + size_t(ty) * tilesX * recordSize), SEEK_SET);
+        ok = std::fread(strip.data(), strip.size(), 1, in) == 1;
+
+        int rows = std::min(ts, header.height - ty * ts);
+        for (int r = 0; r < rows && ok; ++r)
+        {
+            for (int tx = 0; tx < tilesX && ok; ++tx)
+            {
+                int columns = std::min(ts, header.width - tx * ts);
+                ok = std::fwrite(&strip[tx * recordSize + size_t(r) * ts * 3], size_t(columns) * 3, 1, out) == 1;
+            }
+        }
+    }
+    std::fclose(in);
+    if (std::fclose(out) != 0 || !ok)
+    {
+        std::cerr << "Cannot convert " << inPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -21,6 +21,7 @@ struct Material
   float reflectance;
   float transmittance;
   float refraction_index;
+  // not owned, the scene keeps the textures alive (Scene::textures)
   Texture *texture;
   // this is for bump mapping
   Texture *bumpMap;
@@ -31,21 +32,7 @@ struct Material
            float refraction_index = 2.3, Texture *texture = nullptr)
       : color(color), ka(ka), kd(kd), ks(ks), exponent(exponent),
         reflectance(reflectance), transmittance(transmittance),
-        refraction_index(refraction_index), texture(texture) {}
-
-  Material(const std::string &textureName, float ka = 0.3,
-           float kd = 0.9, float ks = 1.0, float exponent = 200.0,
-           float reflectance = 0.8, float transmittance = 0.0,
-           float refraction_index = 2.3)
-      : color(Vector3(1.0, 1.0, 1.0)), ka(ka), kd(kd), ks(ks), exponent(exponent),
-        reflectance(reflectance), transmittance(transmittance),
-        refraction_index(refraction_index), texture(nullptr)
-  {
-    if (!textureName.empty())
-    {
-      texture = new Texture(textureName);
-    }
-  }
+        refraction_index(refraction_index), texture(texture), bumpMap(nullptr) {}
 
   // textureCoordinates function for texture mapping
   Vector2 textureCoordinates(const Vector3 &point) const
@@ -0,0 +1,193 @@
+// header for mesh geometry in memory (MeshArrays) and the binary mesh file format
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+#include "Vector2.h"
+#include "Vector3.h"
+#include "ObjParser.h"
+
+static_assert(sizeof(Vector3) == 3 * sizeof(float) && sizeof(Vector2) == 2 * sizeof(float), "mesh files store packed floats");
+static_assert(sizeof(MeshData::Corner) == 3 * sizeof(int32_t), "mesh files store packed corners");
+
+// mesh arrays structure: read-only view of a mesh's geometry, either the vectors of a parsed
+// OBJ or the arrays of a mapped mesh file, used in place. owner keeps the storage alive, so
+// copies are cheap and can be shared by any number of models.
+struct MeshArrays
+{
+    const Vector3 *vertices;
+    size_t vertexCount;
+    const Vector2 *textures;
+    size_t textureCount;
+    const Vector3 *normals;
+    size_t normalCount;
+    // three per triangle
+    const MeshData::Corner *corners;
+    size_t cornerCount;
+
+    std::shared_ptr<const void> owner;
+
+    MeshArrays()
+        : vertices(nullptr), vertexCount(0), textures(nullptr), textureCount(0), normals(nullptr), normalCount(0),
+          corners(nullptr), cornerCount(0) {}
+
+    // false for the empty result of a failed load
+    bool isLoaded() const
+    {
+        return owner != nullptr;
+    }
+};
+
+// arrays of a parsed OBJ (shares the MeshData)
+MeshArrays meshArrays(const std::shared_ptr<const MeshData> &mesh)
+{
+    MeshArrays arrays;
+    arrays.vertices = mesh->vertices.data();
+    arrays.vertexCount = mesh->vertices.size();
+    arrays.textures = mesh->textures.data();
+    arrays.textureCount = mesh->textures.size();
+    arrays.normals = mesh->normals.data();
+    arrays.normalCount = mesh->normals.size();
+    arrays.corners = mesh->corners.data();
+    arrays.cornerCount = mesh->corners.size();
+    arrays.owner = mesh;
+    return arrays;
+}
+
+// mesh file header structure. The arrays follow at the given offsets (64-byte aligned, from
+// the start of the file): vertices and normals as float x, y, z, texture coordinates as
+// float u, v and corners as int32 vertex, texture, normal index (0-based, -1 = none), three
+// per triangle. Everything is in the writer's byte order, byteOrder tells which.
+struct MeshFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t reserved;
+    uint64_t vertexCount, textureCount, normalCount, cornerCount;
+    uint64_t vertexOffset, textureOffset, normalOffset, cornerOffset;
+};
+
+const uint32_t meshFileByteOrder = 0x01020304;
+
+// write the mesh as a binary mesh file
+bool writeMeshFile(const MeshArrays &mesh, const std::string &path)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    MeshFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "RTMS", 4);
+    header.version = 1;
+    header.byteOrder = meshFileByteOrder;
+    header.vertexCount = mesh.vertexCount;
+    header.textureCount = mesh.textureCount;
+    header.normalCount = mesh.normalCount;
+    header.cornerCount = mesh.cornerCount;
+
+    auto align = [](uint64_t offset)
+    { return (offset + 63) / 64 * 64; };
+    header.vertexOffset = align(sizeof(header));
+    header.textureOffset = align(header.vertexOffset + sizeof(Vector3) * mesh.vertexCount);
+    header.normalOffset = align(header.textureOffset + sizeof(Vector2) * mesh.textureCount);
+    header.cornerOffset = align(header.normalOffset + sizeof(Vector3) * mesh.normalCount);
+
+    const char zeros[64] = {0};
+    uint64_t written = 0;
+    auto put = [&](uint64_t offset, const void *data, size_t size)
+    {
+        out.write(zeros, offset - written);
+        out.write(static_cast<const char *>(data), size);
+        written = offset + size;
+    };
+    put(0, &header, sizeof(header));
+    put(header.vertexOffset, mesh.vertices, sizeof(Vector3) * mesh.vertexCount);
+    put(header.textureOffset, mesh.textures, sizeof(Vector2) * mesh.textureCount);
+    put(header.normalOffset, mesh.normals, sizeof(Vector3) * mesh.normalCount);
+    put(header.cornerOffset, mesh.corners, sizeof(MeshData::Corner) * mesh.cornerCount);
+    return static_cast<bool>(out);
+}
+
+// true if the file starts like a mesh file (anything else is taken for an OBJ)
+bool isMeshFile(const MappedFile &file)
+{
+    return file.bytes() >= 4 && std::memcmp(file.begin(), "RTMS", 4) == 0;
+}
+
+// map a mesh file and point the arrays into the mapping (nothing is copied or parsed); false
+// if the header, the sizes or the indices do not check out
+bool mapMeshFile(const std::shared_ptr<MappedFile> &file, MeshArrays &mesh)
+{
+    if (file->bytes() < sizeof(MeshFileHeader))
+        return false;
+    const char *base = file->begin();
+    MeshFileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, "RTMS", 4) != 0 || header.version != 1 || header.byteOrder != meshFileByteOrder)
+        return false;
+
+    auto fits = [&file](uint64_t offset, uint64_t count, size_t elementSize)
+    { return offset % 64 == 0 && offset <= file->bytes() && count <= (file->bytes() - offset) / elementSize; };
+    if (!fits(header.vertexOffset, header.vertexCount, sizeof(Vector3)) || !fits(header.textureOffset, header.textureCount, sizeof(Vector2)) ||
+        !fits(header.normalOffset, header.normalCount, sizeof(Vector3)) || !fits(header.cornerOffset, header.cornerCount, sizeof(MeshData::Corner)))
+        return false;
+
+    mesh.vertices = reinterpret_cast<const Vector3 *>(base + header.vertexOffset);
+    mesh.vertexCount = header.vertexCount;
+    mesh.textures = reinterpret_cast<const Vector2 *>(base + header.textureOffset);
+    mesh.textureCount = header.textureCount;
+    mesh.normals = reinterpret_cast<const Vector3 *>(base + header.normalOffset);
+    mesh.normalCount = header.normalCount;
+    mesh.corners = reinterpret_cast<const MeshData::Corner *>(base + header.cornerOffset);
+    mesh.cornerCount = header.cornerCount;
+
+    for (size_t k = 0; k < mesh.cornerCount; ++k)
+    {
+        const MeshData::Corner &corner = mesh.corners[k];
+        if (corner.v < 0 || static_cast<uint64_t>(corner.v) >= mesh.vertexCount || corner.t < -1 ||
+            (corner.t >= 0 && static_cast<uint64_t>(corner.t) >= mesh.textureCount) || corner.n < -1 ||
+            (corner.n >= 0 && static_cast<uint64_t>(corner.n) >= mesh.normalCount))
+            return false;
+    }
+    mesh.owner = file;
+    return true;
+}
+
+// load a mesh for <mesh name="...">: a binary mesh file (recognized by its header) is
+// mapped, anything else is parsed as OBJ. An empty result (!isLoaded()) if that fails.
+MeshArrays loadMesh(const std::string &path)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<MappedFile> file(new MappedFile(path, MADV_WILLNEED));
+    MeshArrays mesh;
+    if (file->isOpen() && isMeshFile(*file))
+    {
+        if (!mapMeshFile(file, mesh))
+        {
+            std::cerr << "Invalid mesh file " << path << " (truncated, another version or byte order, or bad indices)" << std::endl;
+            return MeshArrays();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Mesh " << path << ": " << mesh.vertexCount << " vertices, " << mesh.cornerCount / 3 << " triangles, "
+                  << file->bytes() / 1e6 << " MB mapped in " << seconds * 1000.0 << " ms" << std::endl;
+        return mesh;
+    }
+    file.reset();
+    std::shared_ptr<MeshData> obj = loadObj(path);
+    return obj ? meshArrays(obj) : MeshArrays();
+}
+
+#endif
@@ -2,97 +2,100 @@
 #ifndef MODEL_H
 #define MODEL_H
 
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <iostream>
+#include <memory>
 
-#include "Triangle.h"
+#include "Ray.h"
 #include "Material.h"
 #include "Vector2.h"
-#include "Material.h"
 #include "Texture.h"
 #include "Transform.h"
+#include "MeshFile.h"
+
+// Moller-Trumbore ray/triangle intersection (t along the ray, u and v barycentric)
+inline bool intersectTriangle(const Vector3 &v0, const Vector3 &v1, const Vector3 &v2, const Ray &ray, float tMin, float tMax, float &t, float &u, float &v)
+{
+    Vector3 edge1 = v1 - v0;
+    Vector3 edge2 = v2 - v0;
+
+    Vector3 pVec = ray.direction.cross(edge2);
+    float det = edge1.dot(pVec);
+
+    if (det == 0.0f)
+        return false;
+
+    float invDet = 1.0f / det;
 
+    Vector3 tVec = ray.origin - v0;
+    u = tVec.dot(pVec) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    Vector3 qVec = tVec.cross(edge1);
+    v = ray.direction.dot(qVec) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = edge2.dot(qVec) * invDet;
+
+    if (t < tMin || t > tMax)
+        return false;
+
+    return true;
+}
+
+// model class: a mesh (shared, never copied per model) with the surface's material and transform
 class Model
 {
 public:
-    std::vector<Vector3> vertices;
-    std::vector<Vector2> textures;
-    std::vector<Vector3> normals;
-    std::vector<Triangle> triangles;
+    MeshArrays mesh;
+    Material material;
     Transform transform;
 
+    // load an OBJ or binary mesh file
     Model(const std::string &filename, const Material &material)
+        : mesh(loadMesh(filename)), material(material) {}
+
+    // model on already loaded (e.g. cached) mesh arrays
+    Model(const MeshArrays &mesh, const Material &material)
+        : mesh(mesh), material(material) {}
+
+    size_t triangleCount() const
     {
-        std::ifstream in(filename, std::ios::in);
-        if (!in)
-        {
-            std::cerr << "Cannot open " << filename << std::endl;
-            exit(1);
-        }
+        return mesh.cornerCount / 3;
+    }
+
+    // intersect triangle f of the mesh (u and v barycentric, for normal())
+    bool intersect(size_t f, const Ray &ray, float tMin, float tMax, float &t, float &u, float &v) const
+    {
+        const MeshData::Corner *c = &mesh.corners[3 * f];
+        return intersectTriangle(mesh.vertices[c[0].v], mesh.vertices[c[1].v], mesh.vertices[c[2].v], ray, tMin, tMax, t, u, v);
+    }
 
-        std::string line;
-        while (std::getline(in, line))
+    // interpolated normal of triangle f at (u, v); corners without a normal get the face normal
+    Vector3 normal(size_t f, float u, float v) const
+    {
+        const MeshData::Corner *c = &mesh.corners[3 * f];
+        Vector3 n[3];
+        bool haveFaceNormal = false;
+        Vector3 faceNormal;
+        for (int k = 0; k < 3; ++k)
         {
-            if (line.substr(0, 2) == "v ")
-            {
-                std::istringstream s(line.substr(2));
-                Vector3 v;
-                s >> v.x;
-                s >> v.y;
-                s >> v.z;
-                vertices.push_back(v);
-            }
-            else if (line.substr(0, 3) == "vt ")
-            {
-                std::istringstream s(line.substr(3));
-                Vector2 t;
-                s >> t.x;
-                s >> t.y;
-                textures.push_back(t);
-            }
-            else if (line.substr(0, 3) == "vn ")
+            if (c[k].n >= 0)
             {
-                std::istringstream s(line.substr(3));
-                Vector3 n;
-                s >> n.x;
-                s >> n.y;
-                s >> n.z;
-                normals.push_back(n);
+                n[k] = mesh.normals[c[k].n];
+                continue;
             }
-            else if (line.substr(0, 2) == "f ")
+            if (!haveFaceNormal)
             {
-                std::istringstream s(line.substr(2));
-                int a, b, c;
-                int aT, bT, cT;
-                int aN, bN, cN;
-
-                char ch;
-
-                // Parsing faces with vertex, texture, and normal indices
-                s >> a >> ch >> aT >> ch >> aN;
-                s >> b >> ch >> bT >> ch >> bN;
-                s >> c >> ch >> cT >> ch >> cN;
-
-                // console checking
-                std::cout << "Face: " << a << " " << b << " " << c << std::endl;
-                // create triangle with texture and normal if the material has texture and normal map
-                if (material.texture)
-                {
-                    triangles.push_back(Triangle(vertices[a - 1], vertices[b - 1], vertices[c - 1],
-                                                 textures[aT - 1], textures[bT - 1], textures[cT - 1],
-                                                 normals[aN - 1], normals[bN - 1], normals[cN - 1],
-                                                 material, material.texture));
-                }
-                else
-                {
-                    triangles.push_back(Triangle(vertices[a - 1], vertices[b - 1], vertices[c - 1],
-                                                 normals[aN - 1], normals[bN - 1], normals[cN - 1],
-                                                 material));
-                }
+                const Vector3 &a = mesh.vertices[c[0].v];
+                faceNormal = (mesh.vertices[c[1].v] - a).cross(mesh.vertices[c[2].v] - a).normalized();
+                haveFaceNormal = true;
             }
+            n[k] = faceNormal;
         }
+        return (1 - u - v) * n[0] + u * n[1] + v * n[2];
     }
 
     // function to get the transform
@@ -0,0 +1,431 @@
+// header for the OBJ parser (memory-mapped file, hand-written number scanner)
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Vector2.h"
+#include "Vector3.h"
+
+// mesh data structure (geometry of an OBJ file, shared by every model built from it)
+struct MeshData
+{
+    std::vector<Vector3> vertices;
+    std::vector<Vector2> textures;
+    std::vector<Vector3> normals;
+
+    // per face corner: vertex, texture and normal index (0-based, -1 = not given)
+    struct Corner
+    {
+        int v, t, n;
+    };
+    std::vector<Corner> corners;
+};
+
+// mapped file class (read-only view of a whole file; advice is the madvise() access pattern)
+class MappedFile
+{
+public:
+    MappedFile(const std::string &path, int advice = MADV_SEQUENTIAL)
+        : data(nullptr), size(0), opened(false)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+        {
+            if (fd >= 0)
+                ::close(fd);
+            return;
+        }
+        size = static_cast<size_t>(info.st_size);
+        opened = true;
+        if (size > 0)
+        {
+            void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                opened = false;
+                size = 0;
+            }
+            else
+            {
+                data = static_cast<const char *>(mapping);
+                madvise(mapping, size, advice);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data)
+            munmap(const_cast<char *>(data), size);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const
+    {
+        return opened;
+    }
+
+    const char *begin() const
+    {
+        return data;
+    }
+
+    const char *end() const
+    {
+        return data + size;
+    }
+
+    size_t bytes() const
+    {
+        return size;
+    }
+
+private:
+    const char *data;
+    size_t size;
+    bool opened;
+};
+
+// number scanners: read one token at p (after blanks) without going past end, advance p.
+// Plain decimals (all OBJ exporters write those) are converted here; anything longer or
+// stranger (inf, nan, hex, 20 digits) goes through strtod on a copy of the token.
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline void skipBlanks(const char *&p, const char *end)
+{
+    while (p < end && isBlank(*p))
+        ++p;
+}
+
+inline bool scanFloat(const char *&p, const char *end, float &value)
+{
+    skipBlanks(p, end);
+    const char *start = p;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        ++p;
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        if (digits < 19)
+            mantissa = mantissa * 10 + (*p - '0'), ++digits;
+        else
+            ++exponent;
+        ++p;
+    }
+    if (p < end && *p == '.')
+    {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (digits < 19)
+                mantissa = mantissa * 10 + (*p - '0'), ++digits, --exponent;
+            ++p;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        bool negativeExponent = q < end && *q == '-';
+        if (q < end && (*q == '-' || *q == '+'))
+            ++q;
+        int e = 0;
+        const char *digitsStart = q;
+        while (q < end && *q >= '0' && *q <= '9')
+        {
+            e = std::min(e * 10 + (*q - '0'), 100000);
+            ++q;
+        }
+        if (q > digitsStart)
+        {
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    // Exact in double when the mantissa fits 53 bits and 10^|exponent| is exact
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    bool delimited = p == end || isBlank(*p) || *p == '\n' || *p == '/';
+    if (digits > 0 && digits < 19 && delimited && mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double d = static_cast<double>(mantissa);
+        d = exponent < 0 ? d / powers[-exponent] : d * powers[exponent];
+        value = static_cast<float>(negative ? -d : d);
+        return true;
+    }
+
+    // Slow path for the rest
+    p = start;
+    char token[64];
+    size_t length = 0;
+    while (p < end && !isBlank(*p) && *p != '\n' && length < sizeof(token) - 1)
+        token[length++] = *p++;
+    token[length] = '\0';
+    char *parsed = nullptr;
+    value = std::strtof(token, &parsed);
+    return parsed != token;
+}
+
+inline bool scanInt(const char *&p, const char *end, int &value)
+{
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        ++p;
+    const char *start = p;
+    long result = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+    value = static_cast<int>(negative ? -result : result);
+    return p > start;
+}
+
+inline void skipLine(const char *&p, const char *end)
+{
+    const void *newline = std::memchr(p, '\n', end - p);
+    p = newline ? static_cast<const char *>(newline) + 1 : end;
+}
+
+// OBJ index (1-based, or negative = relative to the elements read so far) to 0-based, -1 if missing
+inline int resolveObjIndex(int index, size_t count)
+{
+    if (index > 0)
+        return index - 1;
+    if (index < 0)
+        return static_cast<int>(count) + index;
+    return -1;
+}
+
+// corner with relative (negative) indices, resolved against the counts of its own chunk
+// only: the chunk's base offsets still have to be added to the flagged components
+struct RelativeCorner
+{
+    size_t corner;
+    // bit 0: v, bit 1: t, bit 2: n
+    int components;
+};
+
+// parse the v, vt, vn and f records of [p, end) into mesh; polygons are split into
+// triangle fans, other records (groups, materials, smoothing) are skipped. With relative set,
+// [p, end) is one chunk of a file: negative indices count from the chunk's start and are
+// listed there for the merge.
+void parseObj(const char *p, const char *end, MeshData &mesh, std::vector<RelativeCorner> *relative = nullptr)
+{
+    std::vector<MeshData::Corner> face;
+    std::vector<int> faceRelative;
+    while (p < end)
+    {
+        skipBlanks(p, end);
+        if (p + 1 >= end)
+            break;
+
+        if (p[0] == 'v' && isBlank(p[1]))
+        {
+            p += 1;
+            Vector3 v;
+            scanFloat(p, end, v.x);
+            scanFloat(p, end, v.y);
+            scanFloat(p, end, v.z);
+            mesh.vertices.push_back(v);
+        }
+        else if (p[0] == 'v' && p[1] == 't' && p + 2 < end && isBlank(p[2]))
+        {
+            p += 2;
+            Vector2 t;
+            scanFloat(p, end, t.x);
+            scanFloat(p, end, t.y);
+            mesh.textures.push_back(t);
+        }
+        else if (p[0] == 'v' && p[1] == 'n' && p + 2 < end && isBlank(p[2]))
+        {
+            p += 2;
+            Vector3 n;
+            scanFloat(p, end, n.x);
+            scanFloat(p, end, n.y);
+            scanFloat(p, end, n.z);
+            mesh.normals.push_back(n);
+        }
+        else if (p[0] == 'f' && isBlank(p[1]))
+        {
+            // corners as v, v/t, v//n or v/t/n
+            p += 1;
+            face.clear();
+            faceRelative.clear();
+            while (true)
+            {
+                skipBlanks(p, end);
+                int v = 0, t = 0, n = 0;
+                if (!scanInt(p, end, v))
+                    break;
+                if (p < end && *p == '/')
+                {
+                    ++p;
+                    scanInt(p, end, t);
+                    if (p < end && *p == '/')
+                    {
+                        ++p;
+                        scanInt(p, end, n);
+                    }
+                }
+                face.push_back(MeshData::Corner{resolveObjIndex(v, mesh.vertices.size()), resolveObjIndex(t, mesh.textures.size()),
+                                                resolveObjIndex(n, mesh.normals.size())});
+                faceRelative.push_back((v < 0 ? 1 : 0) | (t < 0 ? 2 : 0) | (n < 0 ? 4 : 0));
+            }
+            for (size_t k = 2; k < face.size(); ++k)
+            {
+                const size_t fan[3] = {0, k - 1, k};
+                for (size_t corner : fan)
+                {
+                    if (relative && faceRelative[corner])
+                        relative->push_back(RelativeCorner{mesh.corners.size(), faceRelative[corner]});
+                    mesh.corners.push_back(face[corner]);
+                }
+            }
+        }
+        skipLine(p, end);
+    }
+}
+
+// parse [begin, end) with up to `threads` threads: the range is cut at line starts into one
+// chunk per thread, each chunk is parsed into its own MeshData, then the chunks are copied
+// into place at the prefix sums of their element counts (and relative indices shifted by them)
+void parseObjParallel(const char *begin, const char *end, MeshData &mesh, int threads)
+{
+    const size_t size = end - begin;
+    std::vector<const char *> cuts(1, begin);
+    for (int k = 1; k < threads; ++k)
+    {
+        const char *cut = std::max(cuts.back(), begin + size * k / threads);
+        if (cut > begin && cut < end && cut[-1] != '\n')
+            skipLine(cut, end);
+        cuts.push_back(cut);
+    }
+    cuts.push_back(end);
+
+    const int chunkCount = static_cast<int>(cuts.size()) - 1;
+    std::vector<MeshData> chunks(chunkCount);
+    std::vector<std::vector<RelativeCorner>> relative(chunkCount);
+    std::vector<std::thread> workers;
+    for (int c = 0; c < chunkCount; ++c)
+        workers.emplace_back([&, c]()
+                             { parseObj(cuts[c], cuts[c + 1], chunks[c], &relative[c]); });
+    for (std::thread &worker : workers)
+        worker.join();
+
+    // Prefix sums: where each chunk's elements start in the merged mesh
+    struct Base
+    {
+        size_t v, t, n, corners;
+    };
+    std::vector<Base> bases(chunkCount + 1, Base{0, 0, 0, 0});
+    for (int c = 0; c < chunkCount; ++c)
+    {
+        bases[c + 1].v = bases[c].v + chunks[c].vertices.size();
+        bases[c + 1].t = bases[c].t + chunks[c].textures.size();
+        bases[c + 1].n = bases[c].n + chunks[c].normals.size();
+        bases[c + 1].corners = bases[c].corners + chunks[c].corners.size();
+    }
+    mesh.vertices.resize(bases[chunkCount].v);
+    mesh.textures.resize(bases[chunkCount].t);
+    mesh.normals.resize(bases[chunkCount].n);
+    mesh.corners.resize(bases[chunkCount].corners);
+
+    workers.clear();
+    for (int c = 0; c < chunkCount; ++c)
+    {
+        workers.emplace_back([&, c]()
+                             {
+                                 MeshData &chunk = chunks[c];
+                                 const Base &base = bases[c];
+                                 std::copy(chunk.vertices.begin(), chunk.vertices.end(), mesh.vertices.begin() + base.v);
+                                 std::copy(chunk.textures.begin(), chunk.textures.end(), mesh.textures.begin() + base.t);
+                                 std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + base.n);
+                                 for (const RelativeCorner &fix : relative[c])
+                                 {
+                                     MeshData::Corner &corner = chunk.corners[fix.corner];
+                                     if (fix.components & 1)
+                                         corner.v += static_cast<int>(base.v);
+                                     if (fix.components & 2)
+                                         corner.t += static_cast<int>(base.t);
+                                     if (fix.components & 4)
+                                         corner.n += static_cast<int>(base.n);
+                                 }
+                                 std::copy(chunk.corners.begin(), chunk.corners.end(), mesh.corners.begin() + base.corners);
+                                 chunk = MeshData(); });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// OBJ loading function (nullptr if the file cannot be read or a face uses a missing vertex,
+// texture coordinate or normal); files of several MB are parsed in parallel, threads = 0
+// picks one thread per 4 MB up to the core count
+std::shared_ptr<MeshData> loadObj(const std::string &filename, int threads = 0)
+{
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file(filename);
+    if (!file.isOpen())
+    {
+        std::cerr << "Cannot open " << filename << std::endl;
+        return nullptr;
+    }
+
+    if (threads <= 0)
+    {
+        int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        threads = static_cast<int>(std::min<size_t>(cores, file.bytes() / (size_t(4) << 20) + 1));
+    }
+
+    std::shared_ptr<MeshData> mesh(new MeshData());
+    if (threads > 1)
+        parseObjParallel(file.begin(), file.end(), *mesh, threads);
+    else
+        parseObj(file.begin(), file.end(), *mesh);
+
+    for (const MeshData::Corner &corner : mesh->corners)
+    {
+        if (corner.v < 0 || static_cast<size_t>(corner.v) >= mesh->vertices.size() || corner.t < -1 ||
+            (corner.t >= 0 && static_cast<size_t>(corner.t) >= mesh->textures.size()) || corner.n < -1 ||
+            (corner.n >= 0 && static_cast<size_t>(corner.n) >= mesh->normals.size()))
+        {
+            std::cerr << "Invalid mesh " << filename << ": a face refers to a missing vertex, texture coordinate or normal" << std::endl;
+            return nullptr;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = file.bytes() / 1e6;
+    std::cout << "Mesh " << filename << ": " << mesh->vertices.size() << " vertices, " << mesh->corners.size() / 3 << " triangles, "
+              << megabytes << " MB in " << seconds * 1000.0 << " ms (" << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s, "
+              << threads << (threads == 1 ? " thread)" : " threads)") << std::endl;
+    return mesh;
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include "Scene.h"
 #include "Material.h"
 #include "Light.h"
+#include "Telemetry.h"
 
 Vector3 ray_trace(const Ray &ray, const Scene &scene, const Camera &camera, int depth = 0)
 {
@@ -21,6 +22,12 @@ Vector3 ray_trace(const Ray &ray, const Scene &scene, const Camera &camera, int
     if (depth > camera.maxBounce)
         return Vector3(0.0, 0.0, 0.0);
 
+    // count the ray (primary rays come from the camera, the rest are reflections/refractions)
+    if (depth == 0)
+        rayCounts.primary++;
+    else
+        rayCounts.secondary++;
+
     float t = std::numeric_limits<float>::max();
     Vector3 point, normal;
     Material hit_material;
@@ -50,6 +57,7 @@ Vector3 ray_trace(const Ray &ray, const Scene &scene, const Camera &camera, int
             float shadow_t = std::numeric_limits<float>::max();
             Vector3 shadow_point, shadow_normal;
             Material shadow_material;
+            rayCounts.shadow++;
 
             // check if the shadow ray intersects with any object in the scene
             if (scene.intersect(shadow_ray, shadow_t, shadow_point, shadow_normal, shadow_material))
@@ -130,6 +138,7 @@ Vector3 ray_trace(const Ray &ray, const Scene &scene, const Camera &camera, int
             float shadow_t = std::numeric_limits<float>::max();
             Vector3 shadow_point, shadow_normal;
             Material shadow_material;
+            rayCounts.shadow++;
 
             // check if the shadow ray intersects with any object in the scene
             if (scene.intersect(shadow_ray, shadow_t, shadow_point, shadow_normal, shadow_material))
@@ -0,0 +1,522 @@
+// header for the resident render server (warm scenes, render requests over a Unix socket)
+#ifndef RENDERSERVER_H
+#define RENDERSERVER_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "render.h"
+
+// Protocol: the client sends one request per line and may send several per connection.
+//   load SCENE        parse the scene and keep it resident     -> "ok loaded"
+//   unload SCENE      drop it (renders in flight keep it alive) -> "ok unloaded"
+//   render SCENE [resolution WxH] [samples N] [position X Y Z] [lookat X Y Z] [fov DEG]
+//                     -> "ok W H TILES", then every finished tile as a TileFileHeader
+//                        followed by its float RGB pixels, then an end header whose
+//                        index is -1 and x0 the RenderStatus
+//                     While the tiles stream in, the client may send
+//                       prioritize X Y W H  (pixels from the top left) to render that region next
+//                       cancel              to stop the render (the end header follows)
+//   shutdown          stop the server                          -> "ok"
+// Failures are answered with "error <reason>".
+
+// render request structure (one parsed "render" line)
+struct RenderRequest
+{
+    std::string sceneId;
+    int width;
+    int height;
+    int samplesPerAxis;
+    bool hasPosition;
+    bool hasLookAt;
+    bool hasFov;
+    Vector3 position;
+    Vector3 lookAt;
+    double fov;
+
+    RenderRequest()
+        : width(0), height(0), samplesPerAxis(0), hasPosition(false), hasLookAt(false), hasFov(false), fov(0.0) {}
+};
+
+// parse the arguments of a render request (everything after "render")
+bool parseRenderRequest(std::istringstream &in, RenderRequest &request, std::string &error)
+{
+    if (!(in >> request.sceneId))
+    {
+        error = "missing scene";
+        return false;
+    }
+
+    std::string key;
+    while (in >> key)
+    {
+        bool ok = true;
+        if (key == "resolution")
+        {
+            std::string value;
+            ok = static_cast<bool>(in >> value) && std::sscanf(value.c_str(), "%dx%d", &request.width, &request.height) == 2 &&
+                 request.width > 0 && request.height > 0;
+        }
+        else if (key == "samples")
+        {
+            // samples per pixel, rounded to a square supersampling grid
+            int samples = 0;
+            ok = static_cast<bool>(in >> samples) && samples > 0;
+            request.samplesPerAxis = std::max(1, static_cast<int>(std::lround(std::sqrt(static_cast<double>(samples)))));
+        }
+        else if (key == "position")
+        {
+            ok = static_cast<bool>(in >> request.position.x >> request.position.y >> request.position.z);
+            request.hasPosition = true;
+        }
+        else if (key == "lookat")
+        {
+            ok = static_cast<bool>(in >> request.lookAt.x >> request.lookAt.y >> request.lookAt.z);
+            request.hasLookAt = true;
+        }
+        else if (key == "fov")
+        {
+            ok = static_cast<bool>(in >> request.fov);
+            request.hasFov = true;
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            error = "bad value for " + key;
+            return false;
+        }
+    }
+    return true;
+}
+
+// write the whole buffer to the socket (false once the peer is gone)
+bool sendAll(int fd, const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool sendLine(int fd, const std::string &line)
+{
+    std::string data = line + "\n";
+    return sendAll(fd, data.data(), data.size());
+}
+
+// read the whole buffer from the socket
+bool receiveAll(int fd, void *data, size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size > 0)
+    {
+        ssize_t got = recv(fd, bytes, size, 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        bytes += got;
+        size -= got;
+    }
+    return true;
+}
+
+// read one line from the socket, byte by byte (requests are short)
+bool receiveLine(int fd, std::string &line)
+{
+    line.clear();
+    char c;
+    while (receiveAll(fd, &c, 1))
+    {
+        if (c == '\n')
+            return true;
+        line += c;
+    }
+    return false;
+}
+
+int connectUnixSocket(const std::string &path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// render server class: scenes are loaded on first use (or by "load") and stay in memory
+// together with their meshes and textures, so a request only pays for the render itself
+class RenderServer
+{
+public:
+    // loader returns nullptr if the scene cannot be loaded
+    typedef std::function<std::shared_ptr<Scene>(const std::string &)> SceneLoader;
+
+    RenderServer(const std::string &socketPath, const SceneLoader &loader, const RenderOptions &options)
+        : socketPath(socketPath), loader(loader), options(options), stopping(false) {}
+
+    RenderServer(const RenderServer &) = delete;
+    RenderServer &operator=(const RenderServer &) = delete;
+
+    // serve until a client sends "shutdown" or stop() is called
+    bool run()
+    {
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+        {
+            std::cerr << "Cannot create socket: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        unlink(socketPath.c_str());
+
+        if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0)
+        {
+            std::cerr << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+            close(listener);
+            return false;
+        }
+        std::cout << "Render server listening on " << socketPath << std::endl;
+
+        // one thread per connection, joined once its client is gone
+        std::vector<std::pair<std::thread, std::shared_ptr<std::atomic<bool>>>> connections;
+        while (!stopping)
+        {
+            for (size_t c = 0; c < connections.size();)
+            {
+                if (*connections[c].second)
+                {
+                    connections[c].first.join();
+                    connections.erase(connections.begin() + c);
+                }
+                else
+                {
+                    ++c;
+                }
+            }
+
+            if (!waitReadable(listener))
+                continue;
+
+            int client = accept(listener, nullptr, nullptr);
+            if (client >= 0)
+            {
+                std::shared_ptr<std::atomic<bool>> done(new std::atomic<bool>(false));
+                connections.emplace_back(std::thread([this, client, done]()
+                                                     {
+                                                         serve(client);
+                                                         close(client);
+                                                         *done = true; }),
+                                         done);
+            }
+        }
+
+        for (auto &connection : connections)
+            connection.first.join();
+        close(listener);
+        unlink(socketPath.c_str());
+        return true;
+    }
+
+    void stop()
+    {
+        stopping = true;
+    }
+
+private:
+    std::string socketPath;
+    SceneLoader loader;
+    RenderOptions options;
+    std::atomic<bool> stopping;
+    std::mutex scenesMutex;
+    std::map<std::string, std::shared_ptr<Scene>> scenes;
+
+    // wait briefly for input so the loops notice stop()
+    bool waitReadable(int fd)
+    {
+        pollfd entry = {fd, POLLIN, 0};
+        return poll(&entry, 1, 200) > 0;
+    }
+
+    std::shared_ptr<Scene> scene(const std::string &id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(scenesMutex);
+            auto it = scenes.find(id);
+            if (it != scenes.end())
+                return it->second;
+        }
+
+        // Load outside the lock, other scenes stay available meanwhile
+        std::shared_ptr<Scene> loaded = loader(id);
+        if (!loaded)
+            return loaded;
+
+        std::lock_guard<std::mutex> lock(scenesMutex);
+        auto inserted = scenes.insert(std::make_pair(id, loaded));
+        return inserted.first->second;
+    }
+
+    void serve(int client)
+    {
+        std::string line;
+        while (!stopping)
+        {
+            if (!waitReadable(client))
+                continue;
+            if (!receiveLine(client, line))
+                return;
+
+            std::istringstream in(line);
+            std::string command, id;
+            in >> command;
+
+            bool ok = true;
+            if (command == "load" && in >> id)
+            {
+                ok = sendLine(client, scene(id) ? "ok loaded" : "error cannot load " + id);
+            }
+            else if (command == "unload" && in >> id)
+            {
+                std::lock_guard<std::mutex> lock(scenesMutex);
+                ok = sendLine(client, scenes.erase(id) ? "ok unloaded" : "error not loaded " + id);
+            }
+            else if (command == "render")
+            {
+                ok = renderRequest(client, in);
+            }
+            else if (command == "shutdown")
+            {
+                stopping = true;
+                sendLine(client, "ok");
+                return;
+            }
+            else
+            {
+                ok = sendLine(client, "error unknown request");
+            }
+
+            if (!ok)
+                return;
+        }
+    }
+
+    // run one render and stream its tiles back as they finish; false if the client left
+    bool renderRequest(int client, std::istringstream &in)
+    {
+        RenderRequest request;
+        std::string error;
+        if (!parseRenderRequest(in, request, error))
+            return sendLine(client, "error " + error);
+
+        std::shared_ptr<Scene> resident = scene(request.sceneId);
+        if (!resident)
+            return sendLine(client, "error cannot load " + request.sceneId);
+
+        Camera camera = resident->camera;
+        if (request.width > 0)
+        {
+            camera.imgWidth = request.width;
+            camera.imgHeight = request.height;
+        }
+        if (request.hasPosition)
+            camera.position = request.position;
+        if (request.hasLookAt)
+            camera.lookAt = request.lookAt;
+        if (request.hasFov)
+            camera.fov = request.fov;
+
+        RenderOptions jobOptions = options;
+        jobOptions.reportInterval = 0;
+        if (request.samplesPerAxis > 0)
+            jobOptions.samplesPerAxis = request.samplesPerAxis;
+
+        // Render threads queue finished tiles, this thread sends them
+        struct Pending
+        {
+            TileFileHeader header;
+            std::vector<Vector3> pixels;
+        };
+        std::mutex pendingMutex;
+        std::condition_variable pendingReady;
+        std::vector<Pending> pending;
+
+        jobOptions.onTile = [&](size_t index, const Tile &tile, const Framebuffer &image)
+        {
+            Pending entry;
+            std::memcpy(entry.header.magic, "RTTL", 4);
+            entry.header.version = 1;
+            entry.header.index = static_cast<int32_t>(index);
+            entry.header.x0 = tile.x0;
+            entry.header.y0 = tile.y0;
+            entry.header.x1 = tile.x1;
+            entry.header.y1 = tile.y1;
+            for (int j = tile.y0; j < tile.y1; ++j)
+            {
+                entry.pixels.insert(entry.pixels.end(), &image.at(tile.x0, j), &image.at(tile.x0, j) + (tile.x1 - tile.x0));
+            }
+
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            pending.push_back(std::move(entry));
+            pendingReady.notify_one();
+        };
+
+        int tileCount = static_cast<int>(makeTiles(camera.imgWidth, camera.imgHeight, std::max(1, jobOptions.tileSize)).size());
+        if (!sendLine(client, "ok " + std::to_string(camera.imgWidth) + " " + std::to_string(camera.imgHeight) + " " + std::to_string(tileCount)))
+            return false;
+
+        std::shared_ptr<RenderJob> job = renderAsync(*resident, camera, jobOptions);
+        std::shared_future<RenderResult> future = job->result();
+
+        bool connected = true;
+        bool finished = false;
+        while (!finished)
+        {
+            // Check completion before draining so the last tiles are not left behind
+            finished = future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+
+            std::vector<Pending> batch;
+            {
+                std::unique_lock<std::mutex> lock(pendingMutex);
+                if (!finished && pending.empty())
+                    pendingReady.wait_for(lock, std::chrono::milliseconds(50));
+                batch.swap(pending);
+            }
+
+            // Requests about the running render
+            pollfd input = {client, POLLIN, 0};
+            std::string line;
+            if (connected && poll(&input, 1, 0) > 0)
+            {
+                if (!receiveLine(client, line))
+                {
+                    connected = false;
+                    job->cancel();
+                }
+                std::istringstream control(line);
+                std::string command;
+                int x, y, w, h;
+                control >> command;
+                if (command == "prioritize" && control >> x >> y >> w >> h)
+                    job->prioritize(x, camera.imgHeight - (y + h), x + w, camera.imgHeight - y);
+                else if (command == "cancel")
+                    job->cancel();
+            }
+
+            for (const Pending &entry : batch)
+            {
+                if (connected && !(sendAll(client, &entry.header, sizeof(entry.header)) &&
+                                   sendAll(client, entry.pixels.data(), entry.pixels.size() * sizeof(Vector3))))
+                {
+                    // Nobody is listening any more
+                    connected = false;
+                    job->cancel();
+                }
+            }
+            if (stopping)
+                job->cancel();
+        }
+        if (!connected)
+            return false;
+
+        TileFileHeader end;
+        std::memset(&end, 0, sizeof(end));
+        std::memcpy(end.magic, "RTTL", 4);
+        end.version = 1;
+        end.index = -1;
+        end.x0 = static_cast<int32_t>(future.get().status);
+        return sendAll(client, &end, sizeof(end));
+    }
+};
+
+// client side: send one render request and collect the streamed tiles into a new image
+bool renderRemote(const std::string &socketPath, const std::string &request, std::shared_ptr<Framebuffer> &image, RenderStatus &status)
+{
+    int fd = connectUnixSocket(socketPath);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    std::string reply;
+    int width = 0, height = 0, tileCount = 0;
+    if (!sendLine(fd, request) || !receiveLine(fd, reply) ||
+        std::sscanf(reply.c_str(), "ok %d %d %d", &width, &height, &tileCount) != 3)
+    {
+        std::cerr << "Render server: " << (reply.empty() ? "no reply" : reply) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    image.reset(new Framebuffer(width, height));
+    bool ok = false;
+    TileFileHeader header;
+    while (receiveAll(fd, &header, sizeof(header)) && std::memcmp(header.magic, "RTTL", 4) == 0)
+    {
+        if (header.index < 0)
+        {
+            status = static_cast<RenderStatus>(header.x0);
+            ok = true;
+            break;
+        }
+        if (header.x0 < 0 || header.y0 < 0 || header.x1 > width || header.y1 > height || header.x0 > header.x1 || header.y0 > header.y1)
+            break;
+
+        bool received = true;
+        for (int j = header.y0; j < header.y1 && received; ++j)
+        {
+            received = receiveAll(fd, &image->at(header.x0, j), sizeof(Vector3) * (header.x1 - header.x0));
+        }
+        if (!received)
+            break;
+    }
+    close(fd);
+    return ok;
+}
+
+#endif
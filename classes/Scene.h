@@ -3,6 +3,9 @@
 #define SCENE_H
 
 #include <vector>
+#include <map>
+#include <string>
+#include <memory>
 
 #include "Sphere.h"
 #include "Light.h"
@@ -18,6 +21,11 @@ public:
     std::vector<Model> models;
     std::vector<Spotlight> spotlights;
     Camera camera;
+    // handles on the registry textures the materials point to; they are freed with the
+    // last scene using them
+    std::vector<std::shared_ptr<Texture>> textures;
+    // output_file attribute of the scene (empty if the XML has none)
+    std::string outputFile;
 
     void add(const Sphere &sphere)
     {
@@ -64,17 +72,18 @@ public:
         }
         for (const auto &model : models)
         {
-            for (const auto &triangle : model.triangles)
+            const size_t triangles = model.triangleCount();
+            for (size_t f = 0; f < triangles; ++f)
             {
                 float t_triangle, u, v;
-                if (triangle.intersect(ray, 0.001f, std::numeric_limits<float>::max(), t_triangle, u, v))
+                if (model.intersect(f, ray, 0.001f, std::numeric_limits<float>::max(), t_triangle, u, v))
                 {
                     if (t_triangle < t)
                     {
                         t = t_triangle;
                         point = ray.origin + ray.direction * t;
-                        normal = triangle.calculateNormal(u, v);
-                        material = triangle.material;
+                        normal = model.normal(f, u, v);
+                        material = model.material;
                     }
                 }
             }
@@ -106,4 +115,53 @@ public:
     }
 };
 
+// scene replica structure (a copy of the scene whose memory lives on one NUMA node)
+struct SceneReplica
+{
+    Scene scene;
+    std::vector<Texture *> textures;
+
+    ~SceneReplica()
+    {
+        for (Texture *texture : textures)
+            delete texture;
+    }
+};
+
+// copy the scene and clone every texture it references; call it from a thread running
+// on the target node so the copy is first-touched (and therefore allocated) there
+SceneReplica *replicateScene(const Scene &source)
+{
+    SceneReplica *replica = new SceneReplica();
+    replica->scene = source;
+
+    std::map<const Texture *, Texture *> clones;
+    auto remap = [&](Texture *&texture)
+    {
+        if (texture == nullptr)
+            return;
+        auto it = clones.find(texture);
+        if (it == clones.end())
+        {
+            Texture *clone = new Texture(*texture);
+            replica->textures.push_back(clone);
+            it = clones.insert(std::make_pair(texture, clone)).first;
+        }
+        texture = it->second;
+    };
+
+    for (auto &sphere : replica->scene.spheres)
+    {
+        remap(sphere.material.texture);
+        remap(sphere.material.bumpMap);
+    }
+    // mesh arrays are read-only and stay shared with the source scene
+    for (auto &model : replica->scene.models)
+    {
+        remap(model.material.texture);
+        remap(model.material.bumpMap);
+    }
+    return replica;
+}
+
 #endif
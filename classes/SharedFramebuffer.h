@@ -0,0 +1,248 @@
+// header for the shared memory framebuffer (live view of a render from another process)
+#ifndef SHAREDFRAMEBUFFER_H
+#define SHAREDFRAMEBUFFER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <new>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Framebuffer.h"
+#include "TileQueue.h"
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "the tile counters must be lock-free to work across processes");
+
+// shared frame header structure, at the start of the segment. It is followed by one 32-bit
+// generation counter per tile (makeTiles() order) and, at pixelOffset, the framebuffer itself
+// (float RGB, bottom row first).
+struct SharedFrameHeader
+{
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t tileSize;
+    int32_t tileCount;
+    uint64_t pixelOffset;
+
+    // bumped when a render into the segment starts, complete is set once it ends
+    std::atomic<uint32_t> frame;
+    std::atomic<uint32_t> complete;
+};
+
+// size of the segment's header and counters (pixels start on a page boundary after them)
+size_t sharedPixelOffset(int tileCount)
+{
+    size_t used = sizeof(SharedFrameHeader) + sizeof(std::atomic<uint32_t>) * tileCount;
+    return (used + 4095) / 4096 * 4096;
+}
+
+// shared framebuffer class (renderer side): creates the segment /NAME and renders straight
+// into it (image() is the render target), so a viewer sees every tile without a copy. The
+// only cost on the render threads is one atomic increment per finished tile.
+class SharedFramebuffer
+{
+public:
+    SharedFramebuffer(const std::string &name, int width, int height, int tileSize)
+        : name(name), data(nullptr), size(0), header(nullptr), generations(nullptr)
+    {
+        const int tileCount = static_cast<int>(makeTiles(width, height, tileSize).size());
+        const size_t pixelOffset = sharedPixelOffset(tileCount);
+        size = pixelOffset + sizeof(Vector3) * width * height;
+
+        // A fresh (black) segment; viewers of a previous one keep their mapping
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            std::cerr << "Cannot create shared memory " << name << std::endl;
+            if (fd >= 0)
+                ::close(fd);
+            return;
+        }
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Cannot map shared memory " << name << std::endl;
+            shm_unlink(name.c_str());
+            return;
+        }
+        data = static_cast<uint8_t *>(mapping);
+
+        // The counters first, the magic last, so a viewer never sees a half-built header
+        header = new (data) SharedFrameHeader;
+        generations = reinterpret_cast<std::atomic<uint32_t> *>(data + sizeof(SharedFrameHeader));
+        for (int i = 0; i < tileCount; ++i)
+            new (&generations[i]) std::atomic<uint32_t>(0);
+        header->version = 1;
+        header->width = width;
+        header->height = height;
+        header->tileSize = tileSize;
+        header->tileCount = tileCount;
+        header->pixelOffset = pixelOffset;
+        header->frame.store(0);
+        header->complete.store(0);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, "RTSM", 4);
+
+        pixels.reset(new Framebuffer(width, height, reinterpret_cast<Vector3 *>(data + pixelOffset)));
+    }
+
+    // the segment disappears with the renderer (viewers keep their mapping until they let go)
+    ~SharedFramebuffer()
+    {
+        if (!data)
+            return;
+        pixels.reset();
+        munmap(data, size);
+        shm_unlink(name.c_str());
+    }
+
+    SharedFramebuffer(const SharedFramebuffer &) = delete;
+    SharedFramebuffer &operator=(const SharedFramebuffer &) = delete;
+
+    bool isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    // the pixels in the segment, for RenderOptions::target
+    std::shared_ptr<Framebuffer> image() const
+    {
+        return pixels;
+    }
+
+    void beginFrame()
+    {
+        header->complete.store(0, std::memory_order_release);
+        header->frame.fetch_add(1, std::memory_order_release);
+    }
+
+    // called from RenderOptions::onTile once the tile's pixels are written
+    void tileDone(size_t index)
+    {
+        generations[index].fetch_add(1, std::memory_order_release);
+    }
+
+    void endFrame()
+    {
+        header->complete.store(1, std::memory_order_release);
+    }
+
+private:
+    std::string name;
+    uint8_t *data;
+    size_t size;
+    SharedFrameHeader *header;
+    std::atomic<uint32_t> *generations;
+    std::shared_ptr<Framebuffer> pixels;
+};
+
+// shared framebuffer view class (viewer side): maps a renderer's segment read-only
+class SharedFramebufferView
+{
+public:
+    SharedFramebufferView(const std::string &name)
+        : data(nullptr), size(0)
+    {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SharedFrameHeader))
+        {
+            if (fd >= 0)
+                ::close(fd);
+            return;
+        }
+        size = static_cast<size_t>(info.st_size);
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            return;
+        data = static_cast<const uint8_t *>(mapping);
+
+        const SharedFrameHeader &h = header();
+        if (std::memcmp(h.magic, "RTSM", 4) != 0 || h.version != 1 || h.pixelOffset + sizeof(Vector3) * h.width * h.height > size)
+        {
+            munmap(const_cast<uint8_t *>(data), size);
+            data = nullptr;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+
+    ~SharedFramebufferView()
+    {
+        if (data)
+            munmap(const_cast<uint8_t *>(data), size);
+    }
+
+    SharedFramebufferView(const SharedFramebufferView &) = delete;
+    SharedFramebufferView &operator=(const SharedFramebufferView &) = delete;
+
+    bool isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    const SharedFrameHeader &header() const
+    {
+        return *reinterpret_cast<const SharedFrameHeader *>(data);
+    }
+
+    // pixel (x, y) is pixels()[y * width + x], row 0 at the bottom like Framebuffer
+    const Vector3 *pixels() const
+    {
+        return reinterpret_cast<const Vector3 *>(data + header().pixelOffset);
+    }
+
+    // tiles whose counter moved since the last call (seen holds the counters between calls,
+    // start with an empty vector to get every tile)
+    std::vector<int> changedTiles(std::vector<uint32_t> &seen) const
+    {
+        const int tileCount = header().tileCount;
+        const std::atomic<uint32_t> *generations = reinterpret_cast<const std::atomic<uint32_t> *>(data + sizeof(SharedFrameHeader));
+        seen.resize(tileCount, ~0u);
+
+        std::vector<int> changed;
+        for (int i = 0; i < tileCount; ++i)
+        {
+            uint32_t generation = generations[i].load(std::memory_order_acquire);
+            if (generation != seen[i])
+            {
+                seen[i] = generation;
+                changed.push_back(i);
+            }
+        }
+        return changed;
+    }
+
+    // pixel rectangle of a tile
+    Tile tile(int index) const
+    {
+        const SharedFrameHeader &h = header();
+        int tilesX = (h.width + h.tileSize - 1) / h.tileSize;
+        Tile tile;
+        tile.x0 = (index % tilesX) * h.tileSize;
+        tile.y0 = (index / tilesX) * h.tileSize;
+        tile.x1 = std::min(tile.x0 + h.tileSize, static_cast<int>(h.width));
+        tile.y1 = std::min(tile.y0 + h.tileSize, static_cast<int>(h.height));
+        tile.view = 0;
+        return tile;
+    }
+
+private:
+    const uint8_t *data;
+    size_t size;
+};
+
+#endif
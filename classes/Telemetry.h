@@ -0,0 +1,185 @@
+// header for the render progress and telemetry counters
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// ray counts structure (plain per-thread tallies bumped by ray_trace)
+struct RayCounts
+{
+    uint64_t primary;
+    uint64_t shadow;
+    uint64_t secondary;
+};
+
+// the calling thread's ray tallies, published to its ThreadCounters once per row
+thread_local RayCounts rayCounts = {0, 0, 0};
+
+// per-thread counters structure (one cache line each, written only by the owning thread)
+struct alignas(64) ThreadCounters
+{
+    std::atomic<uint64_t> rows;
+    std::atomic<uint64_t> tiles;
+    std::atomic<uint64_t> primaryRays;
+    std::atomic<uint64_t> shadowRays;
+    std::atomic<uint64_t> secondaryRays;
+
+    ThreadCounters() : rows(0), tiles(0), primaryRays(0), shadowRays(0), secondaryRays(0) {}
+
+    // single writer, so a relaxed load/store pair is enough (no locked read-modify-write)
+    static void bump(std::atomic<uint64_t> &counter, uint64_t amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // copy the thread's ray tallies into the shared counters
+    void publishRays()
+    {
+        primaryRays.store(rayCounts.primary, std::memory_order_relaxed);
+        shadowRays.store(rayCounts.shadow, std::memory_order_relaxed);
+        secondaryRays.store(rayCounts.secondary, std::memory_order_relaxed);
+    }
+};
+
+// render stats structure (sum over all threads)
+struct RenderStats
+{
+    uint64_t rows;
+    uint64_t tiles;
+    uint64_t primaryRays;
+    uint64_t shadowRays;
+    uint64_t secondaryRays;
+
+    uint64_t rays() const
+    {
+        return primaryRays + shadowRays + secondaryRays;
+    }
+};
+
+class Telemetry
+{
+public:
+    Telemetry(int threadCount) : threadCount(threadCount), counters(nullptr)
+    {
+        void *memory = nullptr;
+        if (posix_memalign(&memory, 64, sizeof(ThreadCounters) * threadCount) != 0)
+            throw std::bad_alloc();
+        counters = static_cast<ThreadCounters *>(memory);
+        for (int t = 0; t < threadCount; ++t)
+            new (&counters[t]) ThreadCounters();
+    }
+
+    ~Telemetry()
+    {
+        for (int t = 0; t < threadCount; ++t)
+            counters[t].~ThreadCounters();
+        std::free(counters);
+    }
+
+    Telemetry(const Telemetry &) = delete;
+    Telemetry &operator=(const Telemetry &) = delete;
+
+    ThreadCounters &thread(int t)
+    {
+        return counters[t];
+    }
+
+    // sample every thread's counters (may be called from any thread while rendering)
+    RenderStats sample() const
+    {
+        RenderStats stats = {0, 0, 0, 0, 0};
+        for (int t = 0; t < threadCount; ++t)
+        {
+            stats.rows += counters[t].rows.load(std::memory_order_relaxed);
+            stats.tiles += counters[t].tiles.load(std::memory_order_relaxed);
+            stats.primaryRays += counters[t].primaryRays.load(std::memory_order_relaxed);
+            stats.shadowRays += counters[t].shadowRays.load(std::memory_order_relaxed);
+            stats.secondaryRays += counters[t].secondaryRays.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    int threadCount;
+    ThreadCounters *counters;
+};
+
+// progress reporter class (one thread printing rays/s and an ETA at a fixed rate)
+class ProgressReporter
+{
+public:
+    ProgressReporter(const Telemetry &telemetry, int totalTiles, int intervalMs)
+        : telemetry(telemetry), totalTiles(totalTiles), interval(intervalMs), stopped(false)
+    {
+        if (intervalMs > 0)
+            reporter = std::thread([this]()
+                                   { run(); });
+    }
+
+    ~ProgressReporter()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        wake.notify_all();
+        if (reporter.joinable())
+            reporter.join();
+    }
+
+private:
+    const Telemetry &telemetry;
+    int totalTiles;
+    std::chrono::milliseconds interval;
+    bool stopped;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread reporter;
+
+    void run()
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto last = start;
+        uint64_t lastRays = 0;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, interval, [this]()
+                              { return stopped; }))
+        {
+            auto now = std::chrono::steady_clock::now();
+            RenderStats stats = telemetry.sample();
+
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            double window = std::chrono::duration<double>(now - last).count();
+            double raysPerSecond = (stats.rays() - lastRays) / window;
+            double fraction = totalTiles > 0 ? static_cast<double>(stats.tiles) / totalTiles : 0.0;
+
+            std::cout << "Rendering progress: " << std::fixed << std::setprecision(1) << fraction * 100.0 << "% | "
+                      << raysPerSecond / 1e6 << " Mrays/s | ETA ";
+            if (fraction > 0.0)
+                std::cout << elapsed * (1.0 - fraction) / fraction << "s";
+            else
+                std::cout << "-";
+            std::cout << std::defaultfloat << std::endl;
+
+            last = now;
+            lastRays = stats.rays();
+        }
+    }
+};
+
+#endif
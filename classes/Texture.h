@@ -24,11 +24,26 @@ public:
     int height;
 
     Texture(const std::string &filename)
-        : filename(filename), dimensions(Vector2(0.0, 0.0)), data(nullptr)
+        : filename(filename), dimensions(Vector2(0.0, 0.0)), data(nullptr), width(0), height(0)
     {
         load();
     }
 
+    // copy constructor (deep copy, used to place a replica of the texels on another NUMA node)
+    Texture(const Texture &other)
+        : filename(other.filename), dimensions(other.dimensions), data(nullptr),
+          width(other.width), height(other.height)
+    {
+        if (other.data != nullptr)
+        {
+            int count = static_cast<int>(dimensions.x) * static_cast<int>(dimensions.y);
+            data = new Vector3[count];
+            std::copy(other.data, other.data + count, data);
+        }
+    }
+
+    Texture &operator=(const Texture &) = delete;
+
     ~Texture()
     {
         if (data != nullptr)
@@ -102,6 +117,12 @@ public:
         return (data != nullptr && dimensions.x > 0 && dimensions.y > 0);
     }
 
+    // memory held by the texels
+    size_t bytes() const
+    {
+        return data != nullptr ? sizeof(Vector3) * width * height : 0;
+    }
+
     // getWidth and getHeight functions
     float getWidth() const
     {
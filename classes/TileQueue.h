@@ -0,0 +1,216 @@
+// header for the tile work queue shared by the render threads
+#ifndef TILEQUEUE_H
+#define TILEQUEUE_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+// Tile structure (pixel rectangle [x0, x1) x [y0, y1) of one view)
+struct Tile
+{
+    int x0, y0, x1, y1;
+    int view;
+};
+
+// split the image into tiles, row by row; with several views (all of the same size)
+// the views' tiles at the same position follow each other
+std::vector<Tile> makeTiles(int width, int height, int tileSize, int views = 1)
+{
+    std::vector<Tile> tiles;
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    for (int ty = 0; ty < tilesY; ++ty)
+    {
+        for (int tx = 0; tx < tilesX; ++tx)
+        {
+            Tile tile;
+            tile.x0 = tx * tileSize;
+            tile.y0 = ty * tileSize;
+            tile.x1 = std::min(tile.x0 + tileSize, width);
+            tile.y1 = std::min(tile.y0 + tileSize, height);
+            for (tile.view = 0; tile.view < views; ++tile.view)
+                tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
+
+// tile order enum (in which order the queue hands out the tiles)
+enum class TileOrder
+{
+    ROWS,
+    // rings around the image center, outwards (the first useful pixels of a preview)
+    SPIRAL
+};
+
+class TileQueue
+{
+public:
+    // every tile of every view; indices handed out by next() refer to this list
+    std::vector<Tile> tiles;
+
+    // queue the tiles selected by the mask (empty mask = all of them) and hand each band
+    // a contiguous run of them, sized by its weight (e.g. the number of threads of a NUMA node)
+    TileQueue(int width, int height, int tileSize, const std::vector<int> &bandWeights, const std::vector<char> &mask = std::vector<char>(),
+              int views = 1, TileOrder tileOrder = TileOrder::ROWS)
+        : tiles(makeTiles(width, height, tileSize, views)), bandCount(static_cast<int>(bandWeights.size())), bands(new Band[bandWeights.size()]),
+          claimed(new std::atomic<char>[tiles.size()]), hasPriority(false)
+    {
+        for (size_t i = 0; i < tiles.size(); ++i)
+            claimed[i].store(0, std::memory_order_relaxed);
+
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            if (mask.empty() || (i < mask.size() && mask[i]))
+                order.push_back(i);
+        }
+
+        int totalWeight = 0;
+        for (int weight : bandWeights)
+            totalWeight += weight;
+
+        size_t begin = 0;
+        int weightSoFar = 0;
+        for (int b = 0; b < bandCount; ++b)
+        {
+            weightSoFar += bandWeights[b];
+            size_t end = (b == bandCount - 1) ? order.size() : order.size() * weightSoFar / std::max(1, totalWeight);
+            bands[b].begin = begin;
+            bands[b].end = end;
+            bands[b].cursor.store(begin);
+
+            // rows owned by the band (in every view): from the previous band's end down to its
+            // last tile (the tiles are in row order, so together the bands cover every row exactly once)
+            bands[b].y0 = (b == 0) ? 0 : bands[b - 1].y1;
+            bands[b].y1 = bands[b].y0;
+            for (size_t k = begin; k < end; ++k)
+            {
+                bands[b].y1 = std::max(bands[b].y1, tiles[order[k]].y1);
+            }
+            if (b == bandCount - 1)
+                bands[b].y1 = height;
+
+            // reorder within the band only, so it keeps its rows
+            if (tileOrder == TileOrder::SPIRAL)
+            {
+                std::stable_sort(order.begin() + begin, order.begin() + end, [this, width, height, tileSize](size_t a, size_t b)
+                                 { return spiralKey(tiles[a], width, height, tileSize) < spiralKey(tiles[b], width, height, tileSize); });
+            }
+            begin = end;
+        }
+    }
+
+    // number of queued tiles
+    int size() const
+    {
+        return static_cast<int>(order.size());
+    }
+
+    // pixel rows owned by a band (the rows its threads should first-touch)
+    void bandRows(int band, int &y0, int &y1) const
+    {
+        y0 = bands[band].y0;
+        y1 = bands[band].y1;
+    }
+
+    // take the next tile: prioritized ones first, then the given band's, then steal from the
+    // other bands once it runs dry
+    bool next(int band, size_t &index)
+    {
+        if (hasPriority.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(priorityMutex);
+            while (!priority.empty())
+            {
+                size_t i = priority.front();
+                priority.pop_front();
+                if (claim(i))
+                {
+                    index = i;
+                    return true;
+                }
+            }
+            hasPriority.store(false, std::memory_order_relaxed);
+        }
+
+        for (int k = 0; k < bandCount; ++k)
+        {
+            Band &b = bands[(band + k) % bandCount];
+            while (b.cursor.load(std::memory_order_relaxed) < b.end)
+            {
+                size_t i = b.cursor.fetch_add(1, std::memory_order_relaxed);
+                if (i >= b.end)
+                    break;
+
+                // skip tiles already taken through the priority list
+                if (claim(order[i]))
+                {
+                    index = order[i];
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // move the queued tiles overlapping the pixel rectangle [x0, x1) x [y0, y1) (of every
+    // view) to the front; safe to call while the threads are taking tiles
+    void prioritize(int x0, int y0, int x1, int y1)
+    {
+        std::vector<size_t> picked;
+        for (size_t i : order)
+        {
+            const Tile &tile = tiles[i];
+            if (tile.x0 < x1 && tile.x1 > x0 && tile.y0 < y1 && tile.y1 > y0 && !claimed[i].load(std::memory_order_relaxed))
+                picked.push_back(i);
+        }
+
+        // the latest request goes first
+        std::lock_guard<std::mutex> lock(priorityMutex);
+        priority.insert(priority.begin(), picked.begin(), picked.end());
+        hasPriority.store(!priority.empty(), std::memory_order_relaxed);
+    }
+
+private:
+    // band structure (padded so the cursors of different nodes do not share a cache line)
+    struct Band
+    {
+        size_t begin;
+        size_t end;
+        int y0, y1;
+        std::atomic<size_t> cursor;
+        char padding[64];
+    };
+
+    std::vector<size_t> order;
+    int bandCount;
+    std::unique_ptr<Band[]> bands;
+
+    // a tile is handed out once, whether from its band or from the priority list
+    std::unique_ptr<std::atomic<char>[]> claimed;
+    std::mutex priorityMutex;
+    std::deque<size_t> priority;
+    std::atomic<bool> hasPriority;
+
+    bool claim(size_t i)
+    {
+        return claimed[i].exchange(1, std::memory_order_relaxed) == 0;
+    }
+
+    // spiral position of a tile: ring (in tiles) around the image center, then angle
+    static std::pair<int, double> spiralKey(const Tile &tile, int width, int height, int tileSize)
+    {
+        double dx = (tile.x0 + tile.x1 - width) / 2.0;
+        double dy = (tile.y0 + tile.y1 - height) / 2.0;
+        int ring = static_cast<int>((std::max(std::abs(dx), std::abs(dy)) + tileSize / 2.0) / tileSize);
+        return std::make_pair(ring, std::atan2(dy, dx));
+    }
+};
+
+#endif
@@ -0,0 +1,92 @@
+// header for tone mapping (linear radiance to display values, run before the 8-bit writers)
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+#include <string>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+
+#include "Framebuffer.h"
+
+// tone mapping operator enum
+enum class ToneMapOperator
+{
+    // cut at 1 (what the 8-bit writers do anyway)
+    CLAMP,
+    // c / (1 + c) per channel, never saturates
+    REINHARD,
+    // Narkowicz's fit of the ACES filmic curve
+    ACES
+};
+
+// tone mapping settings (the defaults leave the image unchanged)
+struct ToneMapSettings
+{
+    ToneMapOperator op;
+
+    // exposure in stops (every pixel is scaled by 2^exposure first)
+    float exposure;
+
+    // encode with the sRGB transfer curve (for linear renders viewed on an sRGB display)
+    bool srgb;
+
+    ToneMapSettings() : op(ToneMapOperator::CLAMP), exposure(0.0f), srgb(false) {}
+
+    bool isIdentity() const
+    {
+        return op == ToneMapOperator::CLAMP && exposure == 0.0f && !srgb;
+    }
+};
+
+// operator by name (clamp, reinhard or aces), false for anything else
+bool parseToneMapOperator(const std::string &name, ToneMapOperator &op)
+{
+    if (name == "clamp")
+        op = ToneMapOperator::CLAMP;
+    else if (name == "reinhard")
+        op = ToneMapOperator::REINHARD;
+    else if (name == "aces")
+        op = ToneMapOperator::ACES;
+    else
+        return false;
+    return true;
+}
+
+// map one linear channel value to [0, 1]
+float toneMapValue(float value, const ToneMapSettings &settings, float scale)
+{
+    float x = std::max(0.0f, value * scale);
+    switch (settings.op)
+    {
+    case ToneMapOperator::REINHARD:
+        x = x / (1.0f + x);
+        break;
+    case ToneMapOperator::ACES:
+        x = (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+        break;
+    default:
+        break;
+    }
+    x = std::min(x, 1.0f);
+
+    if (settings.srgb)
+        x = x <= 0.0031308f ? 12.92f * x : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+    return x;
+}
+
+// tone mapped copy of a linear image (e.g. a render, or a PFM read back with readPFM())
+std::shared_ptr<Framebuffer> toneMap(const Framebuffer &image, const ToneMapSettings &settings)
+{
+    std::shared_ptr<Framebuffer> mapped(new Framebuffer(image.width, image.height));
+    const float scale = std::pow(2.0f, settings.exposure);
+    const size_t count = static_cast<size_t>(image.width) * image.height;
+    for (size_t k = 0; k < count; ++k)
+    {
+        const Vector3 &pixel = image.pixels[k];
+        mapped->pixels[k] = Vector3(toneMapValue(pixel.x, settings, scale), toneMapValue(pixel.y, settings, scale), toneMapValue(pixel.z, settings, scale));
+    }
+    return mapped;
+}
+
+#endif
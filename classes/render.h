@@ -12,115 +12,562 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <chrono>
 
 #include "Vector3.h"
 #include "Ray.h"
 #include "Sphere.h"
 #include "Scene.h"
 #include "RayTrace.h"
+#include "Affinity.h"
+#include "Framebuffer.h"
+#include "TileQueue.h"
+#include "ImageWriter.h"
+#include "Telemetry.h"
+#include "Coordinator.h"
+#include "Checkpoint.h"
+#include "Hash.h"
 
 // Define the number of threads to use
 const int numThreads = 16;
 
-void renderRegion(const Scene &scene, const Camera &camera, Vector3 *image, int startX, int startY, int endX, int endY, int width, std::atomic<int> &progress)
+// Define the default tile size (pixels per tile edge)
+const int defaultTileSize = 32;
+
+// Define the samples per pixel of renderRegion (2x2 supersampling)
+const int samplesPerPixel = 4;
+
+// render options structure (thread count, tile size, thread pinning and NUMA placement)
+struct RenderOptions
+{
+    int threads;
+    int tileSize;
+    bool pinThreads;
+    bool numaLocal;
+
+    // the job stops between tiles once the deadline has passed
+    std::chrono::steady_clock::time_point deadline;
+
+    // called by the render thread that finished a tile (index as in makeTiles())
+    std::function<void(size_t, const Tile &, const Framebuffer &)> onTile;
+
+    // progress report interval in milliseconds (0 = silent)
+    int reportInterval;
+
+    // tiles to render, indexed like makeTiles() (empty = the whole image)
+    std::vector<char> tileMask;
+
+    // render into this image instead of a new one (e.g. tiles restored from a checkpoint; first view only)
+    std::shared_ptr<Framebuffer> target;
+
+    // supersampling grid per pixel edge (2 = the default 2x2, samplesPerPixel)
+    int samplesPerAxis;
+
+    // crop window in framebuffer pixels (row 0 is the bottom of the written image); only
+    // the tiles it overlaps are queued and only its pixels rendered. Empty = the whole frame.
+    Tile crop;
+
+    // order of the tiles (center-out spiral by default, so previews fill from the middle)
+    TileOrder tileOrder;
+
+    // preview level: trace only the pixels on the pixelStep grid, skipping those on the
+    // skipStep grid (done by the previous level, 0 = none), and fill each traced pixel's
+    // pixelStep x pixelStep block with it (1 and 0 = the full image). Both grids start at each
+    // tile's corner (clipped to the crop window), so the levels 8, 4, 2 and 1 of
+    // renderProgressive() trace every pixel once and together cost one normal render.
+    int pixelStep;
+    int skipStep;
+
+    // out-of-core mode: when set no image is allocated; every thread hands its tile buffer
+    // (pixel (x, y) of the tile at at(x - x0, y - y0), rows padded past tileSize) over here instead
+    // of copying it into the image, so resident memory does not grow with the resolution. onTile
+    // is not called and the result has no images. Not for preview levels (pixelStep > 1 or skipStep > 0).
+    std::function<void(size_t, const Tile &, const Framebuffer &)> onTileBuffer;
+
+    RenderOptions()
+        : threads(numThreads), tileSize(defaultTileSize), pinThreads(false), numaLocal(false),
+          deadline(std::chrono::steady_clock::time_point::max()), reportInterval(0), samplesPerAxis(2), crop(Tile{0, 0, 0, 0, 0}),
+          tileOrder(TileOrder::SPIRAL), pixelStep(1), skipStep(0) {}
+};
+
+// render one pixel (average of the grid x grid supersampling grid, 2x2 by default)
+Vector3 renderPixel(const Scene &scene, const Camera &camera, int i, int j, int grid = 2)
 {
-    int totalLines = endY - startY;
-    int renderedLines = 0;
-    int updateThreshold = totalLines / 10;
+    Vector3 colorSum(0.0f, 0.0f, 0.0f);
+
+    // Supersampling over the grid
+    for (int dy = 0; dy < grid; ++dy)
+    {
+        for (int dx = 0; dx < grid; ++dx)
+        {
+            // Compute primary ray direction with offset for supersampling
+            float u = (i + (dx + 0.5f) / grid - 0.5f) / camera.imgWidth;
+            float v = (j + (dy + 0.5f) / grid - 0.5f) / camera.imgHeight;
+            Ray ray = camera.generateRay(u, v);
 
+            // Cast ray and accumulate color
+            colorSum = colorSum + ray_trace(ray, scene, camera);
+        }
+    }
+
+    // Average color
+    return colorSum / static_cast<float>(grid * grid);
+}
+
+// render the pixels [startX, endX) x [startY, endY) into an image `width` pixels wide whose
+// pixel (0, 0) is (originX, originY) of the frame (the whole frame by default, or a tile buffer)
+void renderRegion(const Scene &scene, const Camera &camera, Vector3 *image, int startX, int startY, int endX, int endY, int width, ThreadCounters &counters, int grid = 2,
+                  int originX = 0, int originY = 0)
+{
     for (int j = startY; j < endY; ++j)
     {
         for (int i = startX; i < endX; ++i)
         {
-            Vector3 colorSum(0.0f, 0.0f, 0.0f);
+            image[(j - originY) * width + (i - originX)] = renderPixel(scene, camera, i, j, grid);
+        }
 
-            // Supersampling over 2x2 grid
-            for (int dy = 0; dy < 2; ++dy)
-            {
-                for (int dx = 0; dx < 2; ++dx)
-                {
-                    // Compute primary ray direction with offset for supersampling
-                    float u = (i + (dx - 0.5f) / 2.0f) / width;
-                    float v = (j + (dy - 0.5f) / 2.0f) / camera.imgHeight;
-                    Ray ray = camera.generateRay(u, v);
-
-                    // Cast ray and accumulate color
-                    colorSum = colorSum + ray_trace(ray, scene, camera);
-                }
-            }
+        // Publish the row to the progress reporter
+        ThreadCounters::bump(counters.rows, 1);
+        counters.publishRays();
+    }
+}
+
+// width of a render thread's tile buffer: tileSize rounded up so every row fills whole 64-byte
+// cache lines (16 pixels of three floats are 3 lines)
+int paddedTileWidth(int tileSize)
+{
+    return (tileSize + 15) / 16 * 16;
+}
 
-            // Average color and store in image
-            Vector3 colorAvg = colorSum / 4.0f;
-            image[j * width + i] = colorAvg;
+// copy a tile rendered into a tile buffer (pixel (x, y) at (x - x0, y - y0)) to its place in the image
+void copyTile(const Framebuffer &tilePixels, const Tile &tile, Framebuffer &image)
+{
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+        const Vector3 *row = &tilePixels.at(0, y - tile.y0);
+        std::copy(row, row + (tile.x1 - tile.x0), &image.at(tile.x0, y));
+    }
+}
+
+// preview level of renderRegion: the pixels on the step grid but not on the skip grid (both
+// starting at (startX, startY)), each filling its step x step block (clipped to the region,
+// which other threads do not touch)
+void renderRegionLevel(const Scene &scene, const Camera &camera, Vector3 *image, int startX, int startY, int endX, int endY, int width, ThreadCounters &counters, int grid,
+                       int step, int skip)
+{
+    for (int j = startY; j < endY; j += step)
+    {
+        for (int i = startX; i < endX; i += step)
+        {
+            if (skip > 0 && (i - startX) % skip == 0 && (j - startY) % skip == 0)
+                continue;
+
+            Vector3 color = renderPixel(scene, camera, i, j, grid);
+            for (int y = j; y < std::min(j + step, endY); ++y)
+                std::fill(&image[y * width + i], &image[y * width + std::min(i + step, endX)], color);
         }
 
-        renderedLines++;
+        ThreadCounters::bump(counters.rows, 1);
+        counters.publishRays();
+    }
+}
 
-        if (renderedLines % updateThreshold == 0)
+// simple barrier so the first-touch pass finishes before any thread starts stealing tiles
+class StartBarrier
+{
+public:
+    StartBarrier(int count) : remaining(count) {}
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (--remaining == 0)
         {
-            // Calculate and print the progress percentage of the region
-            float progressPercentage = static_cast<float>(renderedLines) / totalLines * 100;
-            std::cout << "Thread " << std::this_thread::get_id() << " progress: " << progressPercentage << "%" << std::endl;
+            released.notify_all();
+            return;
         }
+        released.wait(lock, [this]()
+                      { return remaining == 0; });
     }
 
-    // Update the overall progress
-    progress += totalLines;
-}
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    int remaining;
+};
+
+// render status enum (how a render job ended)
+enum class RenderStatus
+{
+    COMPLETED,
+    CANCELLED,
+    DEADLINE_EXCEEDED
+};
+
+// render result structure (the final image, partially filled unless the job completed)
+struct RenderResult
+{
+    RenderStatus status;
+    std::shared_ptr<Framebuffer> image;
+
+    // one image per camera of a multi-view job (views[0] is image)
+    std::vector<std::shared_ptr<Framebuffer>> views;
+};
 
-void render(const Scene &scene, const Camera &camera)
+// render job class (handle of a render running in the background)
+class RenderJob
 {
-    const int width = camera.imgWidth;
-    const int height = camera.imgHeight;
-    Vector3 *image = new Vector3[width * height];
+public:
+    RenderJob(const Scene &scene, const Camera &camera, const RenderOptions &options)
+        : RenderJob(scene, std::vector<Camera>(1, camera), options) {}
 
-    // Calculate region dimensions
-    int regionWidth = width / numThreads;
-    int regionHeight = height / numThreads;
+    // several views of the scene (same resolution) in one job, their tiles share one queue
+    RenderJob(const Scene &scene, const std::vector<Camera> &cameras, const RenderOptions &options)
+        : scene(scene), cameras(cameras), options(options), cancelRequested(false), stopReason(0), tilesDone(0), tileCount(0),
+          telemetry(std::max(1, options.threads)), queue(nullptr)
+    {
+        future = promise.get_future().share();
+    }
 
-    std::vector<std::thread> threads;
+    // the destructor cancels the job and waits for its threads
+    ~RenderJob()
+    {
+        cancel();
+        if (coordinator.joinable())
+            coordinator.join();
+    }
 
-    std::atomic<int> progress(0);
+    RenderJob(const RenderJob &) = delete;
+    RenderJob &operator=(const RenderJob &) = delete;
 
-    for (int t = 0; t < numThreads; ++t)
+    // future for the final image
+    std::shared_future<RenderResult> result() const
     {
-        int startX = t * regionWidth;
-        int endX = startX + regionWidth;
-        int startY = 0;
-        int endY = height;
+        return future;
+    }
 
-        threads.emplace_back([startX, endX, startY, endY, &scene, &camera, &image, &progress, width]()
-                             { renderRegion(scene, camera, image, startX, startY, endX, endY, width, progress); });
+    // request cancellation (checked by the render threads between tiles)
+    void cancel()
+    {
+        cancelRequested.store(true);
+    }
+
+    bool isCancelled() const
+    {
+        return cancelRequested.load();
     }
 
-    // Wait for all threads to finish before writing to file
-    for (auto &thread : threads)
+    // fraction of the tiles finished so far
+    float progress() const
     {
-        thread.join();
+        int total = tileCount.load();
+        return total > 0 ? static_cast<float>(tilesDone.load()) / total : 0.0f;
     }
 
-    // Write to file
-    std::ofstream ofs;
-    ofs.open("./output.ppm");
-    ofs << "P3\n"
-        << width << " " << height << "\n255\n";
-    for (int j = height - 1; j >= 0; --j)
+    // render the tiles overlapping the pixel rectangle [x0, x1) x [y0, y1) next (e.g. where
+    // the user clicked in a preview); rows count from the bottom like the framebuffer
+    void prioritize(int x0, int y0, int x1, int y1)
     {
-        for (int i = 0; i < width; ++i)
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (queue)
+            queue->prioritize(x0, y0, x1, y1);
+        else
+            pendingPriorities.push_back(Tile{x0, y0, x1, y1, 0});
+    }
+
+    // ray and tile counts so far (cheap, safe to poll while rendering)
+    RenderStats stats() const
+    {
+        return telemetry.sample();
+    }
+
+    void start()
+    {
+        coordinator = std::thread([this]()
+                                  { run(); });
+    }
+
+private:
+    const Scene &scene;
+    std::vector<Camera> cameras;
+    RenderOptions options;
+    std::atomic<bool> cancelRequested;
+    std::atomic<int> stopReason;
+    std::atomic<int> tilesDone;
+    std::atomic<int> tileCount;
+    std::promise<RenderResult> promise;
+    std::shared_future<RenderResult> future;
+    std::thread coordinator;
+    Telemetry telemetry;
+
+    // the queue while run() is using it, and regions prioritized before it existed
+    std::mutex queueMutex;
+    TileQueue *queue;
+    std::vector<Tile> pendingPriorities;
+
+    // true once the job was cancelled or ran past its deadline
+    bool shouldStop()
+    {
+        if (stopReason.load(std::memory_order_relaxed) != 0)
+            return true;
+
+        if (cancelRequested.load(std::memory_order_relaxed))
+        {
+            stopReason.store(static_cast<int>(RenderStatus::CANCELLED));
+            return true;
+        }
+        if (std::chrono::steady_clock::now() > options.deadline)
+        {
+            stopReason.store(static_cast<int>(RenderStatus::DEADLINE_EXCEEDED));
+            return true;
+        }
+        return false;
+    }
+
+    void run()
+    {
+        const int width = cameras[0].imgWidth;
+        const int height = cameras[0].imgHeight;
+        const int viewCount = static_cast<int>(cameras.size());
+        const int threadCount = std::max(1, options.threads);
+        const int tileSize = std::max(1, options.tileSize);
+
+        // Spread the threads round-robin over the NUMA nodes
+        std::vector<NumaNode> nodes = detectNumaNodes();
+        const int nodeCount = static_cast<int>(nodes.size());
+        const bool replicate = options.numaLocal && nodeCount > 1;
+
+        // One tile band per node when NUMA placement is requested, otherwise a single shared band
+        int bandCount = options.numaLocal ? nodeCount : 1;
+        std::vector<int> bandThreads(bandCount, 0);
+        for (int t = 0; t < threadCount; ++t)
+        {
+            bandThreads[options.numaLocal ? t % nodeCount : 0]++;
+        }
+
+        // Drop the tiles outside the crop window
+        const Tile crop = {std::max(0, options.crop.x0), std::max(0, options.crop.y0), std::min(width, options.crop.x1), std::min(height, options.crop.y1), 0};
+        const bool cropped = options.crop.x0 < options.crop.x1 && options.crop.y0 < options.crop.y1;
+        std::vector<char> mask = options.tileMask;
+        if (cropped)
+        {
+            std::vector<Tile> all = makeTiles(width, height, tileSize, viewCount);
+            mask.resize(all.size(), mask.empty() ? 1 : 0);
+            for (size_t i = 0; i < all.size(); ++i)
+            {
+                if (all[i].x1 <= crop.x0 || all[i].x0 >= crop.x1 || all[i].y1 <= crop.y0 || all[i].y0 >= crop.y1)
+                    mask[i] = 0;
+            }
+        }
+
+        TileQueue tileQueue(width, height, tileSize, bandThreads, mask, viewCount, options.tileOrder);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (const Tile &region : pendingPriorities)
+                tileQueue.prioritize(region.x0, region.y0, region.x1, region.y1);
+            queue = &tileQueue;
+        }
+        const bool streaming = static_cast<bool>(options.onTileBuffer);
+        // preview levels (and the last level of renderProgressive()) write in place
+        const bool previewLevel = options.pixelStep > 1 || options.skipStep > 0;
+        bool firstTouch = options.numaLocal && !options.target;
+        std::vector<std::shared_ptr<Framebuffer>> images;
+        for (int v = 0; v < viewCount && !streaming; ++v)
+        {
+            bool useTarget = v == 0 && options.target;
+            images.push_back(useTarget ? options.target : std::shared_ptr<Framebuffer>(new Framebuffer(width, height, firstTouch)));
+        }
+        tileCount.store(tileQueue.size());
+
+        // Copy the scene onto every node (built by a thread living on that node)
+        std::vector<std::unique_ptr<SceneReplica>> replicas(replicate ? nodeCount : 0);
+        if (replicate)
+        {
+            std::vector<std::thread> builders;
+            for (int n = 0; n < nodeCount; ++n)
+            {
+                builders.emplace_back([this, n, &nodes, &replicas]()
+                                      {
+                                          pinCurrentThread(nodes[n].cpus);
+                                          replicas[n].reset(replicateScene(scene)); });
+            }
+            for (auto &builder : builders)
+            {
+                builder.join();
+            }
+        }
+
+        std::vector<std::thread> threads;
+
+        StartBarrier barrier(threadCount);
+        ProgressReporter reporter(telemetry, tileQueue.size(), options.reportInterval);
+
+        for (int t = 0; t < threadCount; ++t)
+        {
+            int node = t % nodeCount;
+            int band = options.numaLocal ? node : 0;
+            int rank = t / (options.numaLocal ? nodeCount : 1);
+
+            threads.emplace_back([this, t, node, band, rank, replicate, nodeCount, firstTouch, cropped, crop, &nodes, &replicas, &bandThreads, &tileQueue, &images, &barrier, width, streaming, previewLevel, tileSize]()
+                                 {
+                                     const std::vector<int> &cpus = nodes[node].cpus;
+                                     if (options.pinThreads)
+                                         pinCurrentThread(std::vector<int>(1, cpus[(t / nodeCount) % cpus.size()]));
+                                     else if (options.numaLocal)
+                                         pinCurrentThread(cpus);
+
+                                     // First-touch this thread's share of its band's rows
+                                     if (firstTouch)
+                                     {
+                                         int y0, y1;
+                                         tileQueue.bandRows(band, y0, y1);
+                                         int rows = y1 - y0;
+                                         for (auto &image : images)
+                                             image->touchRows(y0 + rows * rank / bandThreads[band], y0 + rows * (rank + 1) / bandThreads[band]);
+                                     }
+                                     barrier.wait();
+
+                                     const Scene &localScene = replicate ? replicas[node]->scene : scene;
+                                     std::vector<Camera> localCameras = cameras;
+                                     ThreadCounters &counters = telemetry.thread(t);
+                                     rayCounts = RayCounts{0, 0, 0};
+
+                                     // this thread's tile buffer: rows padded to whole cache lines and first-touched
+                                     // here (the constructor clears it), so the pixels are accumulated in lines no
+                                     // other core writes to; the only pixels held in out-of-core mode
+                                     std::unique_ptr<Framebuffer> tileBuffer(new Framebuffer(paddedTileWidth(tileSize), tileSize));
+
+                                     size_t index;
+                                     while (!shouldStop() && tileQueue.next(band, index))
+                                     {
+                                         // Border tiles of a crop window only render their part of it
+                                         Tile tile = tileQueue.tiles[index];
+                                         if (cropped)
+                                         {
+                                             tile.x0 = std::max(tile.x0, crop.x0);
+                                             tile.y0 = std::max(tile.y0, crop.y0);
+                                             tile.x1 = std::min(tile.x1, crop.x1);
+                                             tile.y1 = std::min(tile.y1, crop.y1);
+                                         }
+                                         int grid = std::max(1, options.samplesPerAxis);
+                                         if (previewLevel)
+                                         {
+                                             // levels keep the pixels of the previous ones, so they write in place
+                                             renderRegionLevel(localScene, localCameras[tile.view], images[tile.view]->pixels, tile.x0, tile.y0, tile.x1, tile.y1, width, counters,
+                                                               grid, options.pixelStep, options.skipStep);
+                                         }
+                                         else
+                                         {
+                                             renderRegion(localScene, localCameras[tile.view], tileBuffer->pixels, tile.x0, tile.y0, tile.x1, tile.y1, tileBuffer->width, counters,
+                                                          grid, tile.x0, tile.y0);
+                                         }
+
+                                         if (streaming)
+                                         {
+                                             ThreadCounters::bump(counters.tiles, 1);
+                                             tilesDone.fetch_add(1, std::memory_order_relaxed);
+                                             options.onTileBuffer(index, tile, *tileBuffer);
+                                             continue;
+                                         }
+
+                                         // Publish the finished tile to the scanline image in one pass
+                                         Framebuffer &image = *images[tile.view];
+                                         if (!previewLevel)
+                                             copyTile(*tileBuffer, tile, image);
+                                         ThreadCounters::bump(counters.tiles, 1);
+                                         tilesDone.fetch_add(1, std::memory_order_relaxed);
+
+                                         if (options.onTile)
+                                             options.onTile(index, tile, image);
+                                     } });
+        }
+
+        // Wait for all threads to finish
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        reporter.stop();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue = nullptr;
+        }
+
+        RenderResult result;
+        result.status = stopReason.load() != 0 ? static_cast<RenderStatus>(stopReason.load()) : RenderStatus::COMPLETED;
+        result.image = streaming ? nullptr : images[0];
+        result.views = images;
+        promise.set_value(result);
+    }
+};
+
+// start a render in the background; the scene must outlive the returned job
+std::shared_ptr<RenderJob> renderAsync(const Scene &scene, const Camera &camera, const RenderOptions &options = RenderOptions())
+{
+    std::shared_ptr<RenderJob> job(new RenderJob(scene, camera, options));
+    job->start();
+    return job;
+}
+
+// render the scene and wait for the image
+std::shared_ptr<Framebuffer> render(const Scene &scene, const Camera &camera, const RenderOptions &options = RenderOptions())
+{
+    std::shared_ptr<RenderJob> job = renderAsync(scene, camera, options);
+    return job->result().get().image;
+}
+
+// progressive render: the frame at 1/8, 1/4, 1/2 and full resolution, refined in place in one
+// image. Every level traces only the pixels the coarser levels have not, so the last level
+// leaves exactly the full render. onLevel(step, image) runs after each level (step 8, 4, 2, 1);
+// stop is polled while rendering and ends the render early, like the deadline.
+RenderResult renderProgressive(const Scene &scene, const Camera &camera, const RenderOptions &options,
+                               const std::function<void(int, const Framebuffer &)> &onLevel, const std::function<bool()> &stop = nullptr)
+{
+    RenderOptions levelOptions = options;
+    if (!levelOptions.target)
+        levelOptions.target.reset(new Framebuffer(camera.imgWidth, camera.imgHeight));
+
+    RenderResult result;
+    for (int step = 8; step >= 1; step /= 2)
+    {
+        levelOptions.pixelStep = step;
+        levelOptions.skipStep = step == 8 ? 0 : step * 2;
+
+        std::shared_ptr<RenderJob> job = renderAsync(scene, camera, levelOptions);
+        std::shared_future<RenderResult> future = job->result();
+        while (future.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready)
         {
-            int index = j * width + i;
-            int ir = int(255.99 * image[index].x);
-            int ig = int(255.99 * image[index].y);
-            int ib = int(255.99 * image[index].z);
-            ofs << ir << " " << ig << " " << ib << "\n";
+            if (stop && stop())
+                job->cancel();
         }
+
+        result = future.get();
+        if (result.status != RenderStatus::COMPLETED)
+            break;
+        if (onLevel)
+            onLevel(step, *result.image);
     }
-    ofs.close();
+    return result;
+}
 
-    delete[] image;
+// start a multi-view render (e.g. a stereo pair or cube map from CameraRig.h); the cameras
+// must share a resolution, onTile gets the view's image and tileMask indexes makeTiles(..., views)
+std::shared_ptr<RenderJob> renderViewsAsync(const Scene &scene, const std::vector<Camera> &cameras, const RenderOptions &options = RenderOptions())
+{
+    std::shared_ptr<RenderJob> job(new RenderJob(scene, cameras, options));
+    job->start();
+    return job;
+}
 
-    // console output
-    std::cout << "Rendering completed!" << std::endl;
+// render every view and wait for the images
+std::vector<std::shared_ptr<Framebuffer>> renderViews(const Scene &scene, const std::vector<Camera> &cameras, const RenderOptions &options = RenderOptions())
+{
+    std::shared_ptr<RenderJob> job = renderViewsAsync(scene, cameras, options);
+    return job->result().get().views;
 }
 
 #endif
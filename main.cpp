@@ -8,6 +8,11 @@
 #include <limits>
 #include <algorithm>
 #include <utility>
+#include <csignal>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include "pugixml.hpp"
 #include "stb_image.h"
 
@@ -18,15 +23,34 @@
 #include "classes/Light.h"
 #include "classes/Camera.h"
 #include "classes/Model.h"
+#include "classes/AssetCache.h"
 #include "classes/RayTrace.h"
 #include "classes/Scene.h"
 #include "classes/render.h"
 #include "classes/Transform.h"
 #include "classes/Spotlight.h"
+#include "classes/Autotune.h"
+#include "classes/Estimate.h"
+#include "classes/RenderServer.h"
+#include "classes/CameraRig.h"
+#include "classes/MappedImage.h"
+#include "classes/ToneMap.h"
+#include "classes/FrameStream.h"
+#include "classes/SharedFramebuffer.h"
+
+// texture from the registry; its handle joins the scene's list so it lives as long as the scene
+Texture *sceneTexture(const std::string &textureName, std::vector<std::shared_ptr<Texture>> &textures)
+{
+    if (textureName.empty())
+        return nullptr;
+    std::shared_ptr<Texture> texture = assetCache().texture(textureName);
+    if (std::find(textures.begin(), textures.end(), texture) == textures.end())
+        textures.push_back(texture);
+    return texture.get();
+}
 
-// Parse the XML file
 // Sphere parsing
-std::vector<Sphere> parseSpheres(const pugi::xml_node &surfacesNode)
+std::vector<Sphere> parseSpheres(const pugi::xml_node &surfacesNode, std::vector<std::shared_ptr<Texture>> &textures)
 {
     std::vector<Sphere> spheres;
 
@@ -145,7 +169,8 @@ std::vector<Sphere> parseSpheres(const pugi::xml_node &surfacesNode)
 
                     // save the attributes to the sphere
                     Vector3 position(x, y, z);
-                    Sphere sphere(position, radius, Material(textureName, ka, kd, ks, exponent, reflectance, transmittance, iof));
+                    Texture *texture = sceneTexture(textureName, textures);
+                    Sphere sphere(position, radius, Material(Vector3(1.0, 1.0, 1.0), ka, kd, ks, exponent, reflectance, transmittance, iof, texture));
 
                     // Parse transformations
                     pugi::xml_node transformNode = node.child("transform");
@@ -228,7 +253,7 @@ Material parseSolidMaterial(const pugi::xml_node &materialNode)
 }
 
 // Parse Material Textured
-Material parseTexturedMaterial(const pugi::xml_node &materialNode)
+Material parseTexturedMaterial(const pugi::xml_node &materialNode, std::vector<std::shared_ptr<Texture>> &textures)
 {
     pugi::xml_node textureNode = materialNode.child("texture");
     std::string textureName = textureNode.attribute("name").as_string();
@@ -248,7 +273,8 @@ Material parseTexturedMaterial(const pugi::xml_node &materialNode)
     std::cout << "Texture: " << textureName << std::endl;
     std::cout << "Phong: ka=" << ka << ", kd=" << kd << ", ks=" << ks << ", exponent=" << exponent << std::endl;
 
-    return Material(textureName, ka, kd, ks, exponent, reflectance, transmittance, iof);
+    Texture *texture = sceneTexture(textureName, textures);
+    return Material(Vector3(1.0, 1.0, 1.0), ka, kd, ks, exponent, reflectance, transmittance, iof, texture);
 }
 
 // Parse Transformations
@@ -295,7 +321,7 @@ Transform parseTransform(const pugi::xml_node &transformNode)
 }
 
 // Parse Model (surface - mesh)
-std::vector<Model> parseModels(const pugi::xml_node &surfacesNode)
+std::vector<Model> parseModels(const pugi::xml_node &surfacesNode, std::vector<std::shared_ptr<Texture>> &textures)
 {
     std::vector<Model> models;
 
@@ -310,7 +336,7 @@ std::vector<Model> parseModels(const pugi::xml_node &surfacesNode)
             {
                 // Parse solid material
                 Material material = parseSolidMaterial(materialNode);
-                Model model(meshName, material);
+                Model model(assetCache().mesh(meshName), material);
 
                 // Parse transform
                 pugi::xml_node transformNode = node.child("transform");
@@ -326,9 +352,8 @@ std::vector<Model> parseModels(const pugi::xml_node &surfacesNode)
             {
                 // Parse textured material
                 materialNode = node.child("material_textured");
-                Material material = parseTexturedMaterial(materialNode);
-                Model model(meshName, material);
-                models.push_back(model);
+                Material material = parseTexturedMaterial(materialNode, textures);
+                Model model(assetCache().mesh(meshName), material);
 
                 // Parse transform
                 pugi::xml_node transformNode = node.child("transform");
@@ -427,11 +452,22 @@ Camera parseCamera(const pugi::xml_node &cameraNode)
     camera.imgHeight = static_cast<int>(vertical);
     camera.maxBounce = static_cast<int>(max_bounces);
 
+    // optional crop window, e.g. <crop left="0.25" top="0.25" right="0.75" bottom="0.75"/>
+    pugi::xml_node cropNode = cameraNode.child("crop");
+    if (cropNode)
+    {
+        camera.cropLeft = cropNode.attribute("left").as_double(0.0);
+        camera.cropTop = cropNode.attribute("top").as_double(0.0);
+        camera.cropRight = cropNode.attribute("right").as_double(1.0);
+        camera.cropBottom = cropNode.attribute("bottom").as_double(1.0);
+    }
+
     return camera;
 }
 
-// scene parsing function
-Scene parseScene(const std::string &filename)
+// camera-only parsing function (resolution and view without loading any asset), optionally
+// with the scene's output_file
+Camera parseSceneCamera(const std::string &filename, std::string *outputFile = nullptr)
 {
     pugi::xml_document doc;
     pugi::xml_parse_result result = doc.load_file(filename.c_str());
@@ -441,17 +477,109 @@ Scene parseScene(const std::string &filename)
         std::cerr << "Error parsing XML: " << result.description() << std::endl;
         exit(EXIT_FAILURE);
     }
+    if (outputFile)
+        *outputFile = doc.child("scene").attribute("output_file").as_string();
+    return parseCamera(doc.child("scene").child("camera"));
+}
+
+// scene assets structure: the files a scene references, collected from the XML before any
+// element is built
+struct SceneAssets
+{
+    std::vector<std::string> meshes;
+    std::vector<std::string> textures;
+};
+
+// first phase: list the meshes and textures of the surfaces (each file once)
+SceneAssets collectAssets(const pugi::xml_node &surfacesNode)
+{
+    SceneAssets assets;
+    auto add = [](std::vector<std::string> &names, const std::string &name)
+    {
+        if (!name.empty() && std::find(names.begin(), names.end(), name) == names.end())
+            names.push_back(name);
+    };
+    for (auto &&node : surfacesNode.children())
+    {
+        std::string nodeName = node.name();
+        if (nodeName == "mesh")
+            add(assets.meshes, node.attribute("name").as_string());
+        if (nodeName == "mesh" || nodeName == "sphere")
+            add(assets.textures, node.child("material_textured").child("texture").attribute("name").as_string());
+    }
+    return assets;
+}
+
+// second phase: load all assets concurrently into the asset cache, so loading takes about as
+// long as the largest one. The texture handles keep the textures registered until the scene
+// built from the cache holds its own. False if a mesh cannot be loaded.
+bool loadAssets(const SceneAssets &assets, std::vector<std::shared_ptr<Texture>> &textures)
+{
+    const size_t count = assets.meshes.size() + assets.textures.size();
+    textures.assign(assets.textures.size(), nullptr);
+    if (count == 0)
+        return true;
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&]()
+    {
+        for (size_t k = next++; k < count; k = next++)
+        {
+            if (k < assets.meshes.size())
+            {
+                if (!assetCache().mesh(assets.meshes[k]).isLoaded())
+                    failed = true;
+            }
+            else
+                textures[k - assets.meshes.size()] = assetCache().texture(assets.textures[k - assets.meshes.size()]);
+        }
+    };
+
+    const size_t threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool)
+        t.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Assets: " << assets.meshes.size() << " meshes, " << assets.textures.size() << " textures in " << seconds * 1000.0
+              << " ms (" << threads << " threads)" << std::endl;
+    return !failed;
+}
+
+// scene parsing function, false if the XML or one of its meshes cannot be loaded
+bool parseScene(const std::string &filename, Scene &scene)
+{
+    pugi::xml_document doc;
+    pugi::xml_parse_result result = doc.load_file(filename.c_str());
+
+    if (!result)
+    {
+        std::cerr << "Error parsing XML: " << result.description() << std::endl;
+        return false;
+    }
 
     pugi::xml_node sceneNode = doc.child("scene");
     if (!sceneNode)
     {
         std::cerr << "Error: No 'scene' node found in XML." << std::endl;
-        exit(EXIT_FAILURE);
+        return false;
     }
 
+    // Load the referenced files up front and in parallel, the elements below then come from
+    // the asset cache
     pugi::xml_node surfacesNode = sceneNode.child("surfaces");
-    std::vector<Sphere> spheres = parseSpheres(surfacesNode);
-    std::vector<Model> models = parseModels(surfacesNode);
+    std::vector<std::shared_ptr<Texture>> loaded;
+    if (!loadAssets(collectAssets(surfacesNode), loaded))
+        return false;
+
+    std::vector<std::shared_ptr<Texture>> textures;
+    std::vector<Sphere> spheres = parseSpheres(surfacesNode, textures);
+    std::vector<Model> models = parseModels(surfacesNode, textures);
 
     pugi::xml_node lightsNode = sceneNode.child("lights");
     std::vector<Light> lights = parseLights(lightsNode);
@@ -459,48 +587,398 @@ Scene parseScene(const std::string &filename)
     pugi::xml_node cameraNode = sceneNode.child("camera");
     Camera camera = parseCamera(cameraNode);
 
-    Scene scene;
+    scene = Scene();
     scene.spheres = spheres;
     scene.models = models;
     scene.lights = lights;
     scene.camera = camera;
+    scene.textures = textures;
+    scene.outputFile = sceneNode.attribute("output_file").as_string();
 
-    return scene;
+    return true;
 }
 
-//  main function
-int main()
+// command line structure (render flags plus the run mode)
+struct CommandLine
+{
+    RenderOptions options;
+
+    // scene file; empty means ask interactively for one of the examples
+    std::string scenePath;
+    bool cameraTransform;
+    bool depthOfField;
+
+    // true if --threads was given (otherwise the default is split between workers or batch jobs)
+    bool threadsGiven;
+
+    // multi-process rendering: coordinator (workers > 0) or worker (workerDir set)
+    int workers;
+    std::string workerDir;
+    std::string workerTiles;
+
+    // flags forwarded to worker processes
+    std::vector<std::string> renderArgs;
+
+    // checkpoint file, save interval in seconds and whether to continue from it
+    std::string checkpointPath;
+    int checkpointInterval;
+    bool resume;
+
+    // autotuning: pick threads / tile size / placement from probe renders (cached per scene and host)
+    bool autotune;
+    bool retune;
+    std::string autotuneCache;
+
+    // resolution override (0 = as in the scene file)
+    int width;
+    int height;
+
+    // print a JSON cost estimate instead of rendering
+    bool estimate;
+
+    // batch mode: file with one scene path per line, rendered batchJobs at a time
+    std::string batchList;
+    int batchJobs;
+
+    // render server socket (--serve), or the server to send requestLine to (--connect)
+    std::string serveSocket;
+    std::string connectSocket;
+    std::string requestLine;
+
+    // camera rig rendered in one job: stereo[:SEP], cube or array:CxR[:SPACING] (empty = one view)
+    std::string views;
+
+    // crop window in image pixels from the top left (width 0 = the scene's <crop>, if any),
+    // and the image to render it into
+    int cropX, cropY, cropWidth, cropHeight;
+    std::string compositePath;
+
+    // progressive preview (1/8, 1/4, 1/2, full) refreshing previewPath after each level
+    bool progressive;
+    std::string previewPath;
+
+    // output image (empty = the scene's output_file, or ./output.ppm) and PNG compression level
+    std::string outputPath;
+    int pngLevel;
+
+    // out-of-core mode: tiles go straight into the memory-mapped output (.ppm, or .rtiles
+    // for the tiled layout) instead of an image in memory; --untile converts .rtiles to PPM
+    bool outOfCore;
+    std::string untileInput;
+    std::string untileOutput;
+
+    // OBJ to binary mesh file conversion (the file can then replace the OBJ in <mesh name>)
+    std::string convertMeshInput;
+    std::string convertMeshOutput;
+
+    // tone mapping of the 8-bit outputs, the linear image (PFM) to keep next to them, and a
+    // saved PFM to tone map instead of rendering
+    ToneMapSettings toneMap;
+    std::string hdrPath;
+    std::string toneMapInput;
+
+    // raw frame stream ("-" = stdout, or a named pipe) replacing the image files, its pixel
+    // format and whether every frame gets a FrameHeader
+    std::string streamPath;
+    FrameFormat streamFormat;
+    bool streamHeaders;
+
+    // POSIX shared memory segment (/NAME) to render into for a live viewer
+    std::string sharedMemory;
+
+    CommandLine()
+        : cameraTransform(false), depthOfField(false), threadsGiven(false), workers(0), checkpointInterval(60), resume(false),
+          autotune(false), retune(false), autotuneCache("./autotune.cache"), width(0), height(0), estimate(false),
+          batchJobs(2), cropX(0), cropY(0), cropWidth(0), cropHeight(0), progressive(false), previewPath("./preview.ppm"),
+          pngLevel(6), outOfCore(false), streamFormat(FrameFormat::RGB8), streamHeaders(true) {}
+};
+
+// print the usage and quit
+void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--scene FILE] [--camera-transform] [--dof] [--resolution WxH]" << std::endl
+              << "       [--threads N] [--tile-size N] [--pin] [--numa] [--report-interval MS]" << std::endl
+              << "       [--workers N [--work-dir DIR]]" << std::endl
+              << "       [--checkpoint FILE [--checkpoint-interval S] [--resume]]" << std::endl
+              << "       [--autotune | --retune] [--autotune-cache FILE]" << std::endl
+              << "       [--estimate]" << std::endl
+              << "       [--batch LIST [--batch-jobs N]]" << std::endl
+              << "       [--serve SOCKET | --connect SOCKET --request LINE]" << std::endl
+              << "       [--views stereo[:SEP] | cube | array:CxR[:SPACING]]" << std::endl
+              << "       [--crop X,Y,W,H] [--composite FILE.ppm|FILE.pfm]" << std::endl
+              << "       [--progressive [--preview FILE]]" << std::endl
+              << "       [--output FILE.ppm|FILE.png] [--png-level 0-9]" << std::endl
+              << "       [--out-of-core] [--untile IN.rtiles OUT.ppm]" << std::endl
+              << "       [--tonemap clamp|reinhard|aces] [--exposure STOPS] [--srgb] [--hdr FILE.pfm]" << std::endl
+              << "       [--tonemap-input FILE.pfm]" << std::endl
+              << "       [--stream FILE|- [--stream-format rgb8|rgbf] [--stream-raw]]" << std::endl
+              << "       [--shm /NAME]" << std::endl
+              << "       [--convert-mesh IN.obj OUT.mesh]" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// command line parsing function
+CommandLine parseArguments(int argc, char **argv)
+{
+    CommandLine cmd;
+    RenderOptions &options = cmd.options;
+    options.reportInterval = 1000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--scene" && hasValue)
+        {
+            cmd.scenePath = argv[++i];
+        }
+        else if (arg == "--camera-transform")
+        {
+            cmd.cameraTransform = true;
+            cmd.renderArgs.push_back(arg);
+        }
+        else if (arg == "--dof")
+        {
+            cmd.depthOfField = true;
+            cmd.renderArgs.push_back(arg);
+        }
+        else if (arg == "--resolution" && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &cmd.width, &cmd.height) != 2 || cmd.width <= 0 || cmd.height <= 0)
+                usage(argv[0]);
+            cmd.renderArgs.push_back(arg);
+            cmd.renderArgs.push_back(argv[i]);
+        }
+        else if (arg == "--estimate")
+        {
+            cmd.estimate = true;
+        }
+        else if (arg == "--batch" && hasValue)
+        {
+            cmd.batchList = argv[++i];
+        }
+        else if (arg == "--batch-jobs" && hasValue)
+        {
+            cmd.batchJobs = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--serve" && hasValue)
+        {
+            cmd.serveSocket = argv[++i];
+        }
+        else if (arg == "--connect" && hasValue)
+        {
+            cmd.connectSocket = argv[++i];
+        }
+        else if (arg == "--request" && hasValue)
+        {
+            cmd.requestLine = argv[++i];
+        }
+        else if (arg == "--views" && hasValue)
+        {
+            cmd.views = argv[++i];
+        }
+        else if (arg == "--crop" && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%d,%d,%d,%d", &cmd.cropX, &cmd.cropY, &cmd.cropWidth, &cmd.cropHeight) != 4 || cmd.cropWidth <= 0 || cmd.cropHeight <= 0)
+                usage(argv[0]);
+        }
+        else if (arg == "--composite" && hasValue)
+        {
+            cmd.compositePath = argv[++i];
+        }
+        else if (arg == "--progressive")
+        {
+            cmd.progressive = true;
+        }
+        else if (arg == "--preview" && hasValue)
+        {
+            cmd.previewPath = argv[++i];
+        }
+        else if (arg == "--output" && hasValue)
+        {
+            cmd.outputPath = argv[++i];
+        }
+        else if (arg == "--png-level" && hasValue)
+        {
+            cmd.pngLevel = std::atoi(argv[++i]);
+        }
+        else if (arg == "--out-of-core")
+        {
+            cmd.outOfCore = true;
+        }
+        else if (arg == "--tonemap" && hasValue)
+        {
+            if (!parseToneMapOperator(argv[++i], cmd.toneMap.op))
+                usage(argv[0]);
+        }
+        else if (arg == "--exposure" && hasValue)
+        {
+            cmd.toneMap.exposure = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (arg == "--srgb")
+        {
+            cmd.toneMap.srgb = true;
+        }
+        else if (arg == "--hdr" && hasValue)
+        {
+            cmd.hdrPath = argv[++i];
+        }
+        else if (arg == "--tonemap-input" && hasValue)
+        {
+            cmd.toneMapInput = argv[++i];
+        }
+        else if (arg == "--stream" && hasValue)
+        {
+            cmd.streamPath = argv[++i];
+        }
+        else if (arg == "--stream-format" && hasValue)
+        {
+            std::string format = argv[++i];
+            if (format != "rgb8" && format != "rgbf")
+                usage(argv[0]);
+            cmd.streamFormat = format == "rgb8" ? FrameFormat::RGB8 : FrameFormat::RGBF;
+        }
+        else if (arg == "--stream-raw")
+        {
+            cmd.streamHeaders = false;
+        }
+        else if (arg == "--shm" && hasValue)
+        {
+            cmd.sharedMemory = argv[++i];
+        }
+        else if (arg == "--untile" && i + 2 < argc)
+        {
+            cmd.untileInput = argv[++i];
+            cmd.untileOutput = argv[++i];
+        }
+        else if (arg == "--convert-mesh" && i + 2 < argc)
+        {
+            cmd.convertMeshInput = argv[++i];
+            cmd.convertMeshOutput = argv[++i];
+        }
+        else if (arg == "--threads" && hasValue)
+        {
+            options.threads = std::atoi(argv[++i]);
+            cmd.threadsGiven = true;
+        }
+        else if (arg == "--tile-size" && hasValue)
+        {
+            options.tileSize = std::atoi(argv[++i]);
+            cmd.renderArgs.push_back(arg);
+            cmd.renderArgs.push_back(argv[i]);
+        }
+        else if (arg == "--pin")
+        {
+            options.pinThreads = true;
+        }
+        else if (arg == "--numa")
+        {
+            options.numaLocal = true;
+        }
+        else if (arg == "--report-interval" && hasValue)
+        {
+            options.reportInterval = std::atoi(argv[++i]);
+            cmd.renderArgs.push_back(arg);
+            cmd.renderArgs.push_back(argv[i]);
+        }
+        else if (arg == "--workers" && hasValue)
+        {
+            cmd.workers = std::atoi(argv[++i]);
+        }
+        else if (arg == "--work-dir" && hasValue)
+        {
+            cmd.workerDir = argv[++i];
+        }
+        else if (arg == "--worker" && hasValue)
+        {
+            cmd.workerDir = argv[++i];
+        }
+        else if (arg == "--worker-tiles" && hasValue)
+        {
+            cmd.workerTiles = argv[++i];
+        }
+        else if (arg == "--checkpoint" && hasValue)
+        {
+            cmd.checkpointPath = argv[++i];
+        }
+        else if (arg == "--checkpoint-interval" && hasValue)
+        {
+            cmd.checkpointInterval = std::atoi(argv[++i]);
+        }
+        else if (arg == "--resume")
+        {
+            cmd.resume = true;
+        }
+        else if (arg == "--autotune")
+        {
+            cmd.autotune = true;
+        }
+        else if (arg == "--retune")
+        {
+            cmd.autotune = true;
+            cmd.retune = true;
+        }
+        else if (arg == "--autotune-cache" && hasValue)
+        {
+            cmd.autotuneCache = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            usage(argv[0]);
+        }
+    }
+    return cmd;
+}
+
+// scene loading function (asks for the example and camera settings unless --scene was given)
+bool loadScene(CommandLine &cmd, Scene &scene)
 {
-    // Prompt the user to enter the file number
-    int fileNumber;
-    std::cout << "Enter the file number (1-9): ";
-    std::cin >> fileNumber;
+    bool interactive = cmd.scenePath.empty();
+
+    if (interactive)
+    {
+        // Prompt the user to enter the file number
+        int fileNumber;
+        std::cout << "Enter the file number (1-9): ";
+        std::cin >> fileNumber;
 
-    // Construct the file name
-    std::stringstream fileNameStream;
-    fileNameStream << "scenes/example" << fileNumber << ".xml";
-    std::string fileName = fileNameStream.str();
+        // Construct the file name
+        std::stringstream fileNameStream;
+        fileNameStream << "scenes/example" << fileNumber << ".xml";
+        cmd.scenePath = fileNameStream.str();
+    }
 
     // Parse the scene from the XML file
-    Scene scene = parseScene(fileName);
+    if (!parseScene(cmd.scenePath, scene))
+        return false;
 
     scene.camera.transform.makeTranslation(-1.0, 1.0, 3.0);
 
-    // Ask the user for isTransform
-    std::cout << "Use camera transform? (y/n): ";
-    std::string isTransformStr;
-    std::cin >> isTransformStr;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    bool ans = (isTransformStr == "y") ? true : false;
-    scene.camera.isTransform = ans;
-
-    // Ask the user for dof
-    std::cout << "Use depth of field? (y/n): ";
-    std::string dofStr;
-    std::cin >> dofStr;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    ans = (dofStr == "y") ? true : false;
-    scene.camera.dof = ans;
+    if (interactive)
+    {
+        // Ask the user for isTransform
+        std::cout << "Use camera transform? (y/n): ";
+        std::string isTransformStr;
+        std::cin >> isTransformStr;
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        cmd.cameraTransform = (isTransformStr == "y") ? true : false;
+
+        // Ask the user for dof
+        std::cout << "Use depth of field? (y/n): ";
+        std::string dofStr;
+        std::cin >> dofStr;
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        cmd.depthOfField = (dofStr == "y") ? true : false;
+    }
+    scene.camera.isTransform = cmd.cameraTransform;
+    scene.camera.dof = cmd.depthOfField;
+    if (cmd.width > 0)
+    {
+        scene.camera.imgWidth = cmd.width;
+        scene.camera.imgHeight = cmd.height;
+    }
 
     // turn on/off spotlight
     bool isSpotLight = false;
@@ -519,8 +997,709 @@ int main()
         scene.addSpotlight(spotlight);
     }
 
-    // Render the scene to an image
-    render(scene, scene.camera);
+    return true;
+}
+
+// scene loading for the single-scene modes: quits if the scene cannot be loaded
+Scene loadScene(CommandLine &cmd)
+{
+    Scene scene;
+    if (!loadScene(cmd, scene))
+        exit(EXIT_FAILURE);
+    return scene;
+}
+
+// camera rig function (the views given by --views, empty if the spec is invalid)
+std::vector<Camera> makeViews(const std::string &spec, const Camera &camera)
+{
+    if (spec.empty())
+        return std::vector<Camera>(1, camera);
+
+    double value = 0.0;
+    int columns = 0, rows = 0;
+    if (spec == "stereo")
+        return stereoCameras(camera, 0.065);
+    if (std::sscanf(spec.c_str(), "stereo:%lf", &value) == 1 && value > 0.0)
+        return stereoCameras(camera, value);
+    if (spec == "cube")
+        return cubeMapCameras(camera);
+
+    int fields = std::sscanf(spec.c_str(), "array:%dx%d:%lf", &columns, &rows, &value);
+    if (fields >= 2 && columns > 0 && rows > 0)
+        return cameraArray(camera, columns, rows, fields == 3 ? value : 0.1);
+    return std::vector<Camera>();
+}
+
+// crop window function: --crop or the scene's <crop>, in framebuffer pixels (whose row 0 is
+// the bottom row of the written image); an empty tile means the whole frame
+Tile cropWindow(const CommandLine &cmd, const Camera &camera)
+{
+    int x0, y0, x1, y1;
+    if (cmd.cropWidth > 0)
+    {
+        x0 = cmd.cropX;
+        y0 = cmd.cropY;
+        x1 = cmd.cropX + cmd.cropWidth;
+        y1 = cmd.cropY + cmd.cropHeight;
+    }
+    else
+    {
+        if (camera.cropLeft <= 0.0 && camera.cropTop <= 0.0 && camera.cropRight >= 1.0 && camera.cropBottom >= 1.0)
+            return Tile{0, 0, 0, 0, 0};
+        x0 = static_cast<int>(std::floor(camera.cropLeft * camera.imgWidth));
+        y0 = static_cast<int>(std::floor(camera.cropTop * camera.imgHeight));
+        x1 = static_cast<int>(std::ceil(camera.cropRight * camera.imgWidth));
+        y1 = static_cast<int>(std::ceil(camera.cropBottom * camera.imgHeight));
+    }
+
+    // flip from image rows (top down) to framebuffer rows (bottom up)
+    return Tile{x0, camera.imgHeight - y1, x1, camera.imgHeight - y0, 0};
+}
+
+// output image path: --output, else the scene's output_file, else ./output.ppm
+std::string outputImagePath(const CommandLine &cmd, const std::string &sceneOutput)
+{
+    if (!cmd.outputPath.empty())
+        return cmd.outputPath;
+    return sceneOutput.empty() ? "./output.ppm" : sceneOutput;
+}
+
+// write a finished image: PFM keeps the linear values, the 8-bit formats get the tone mapping
+bool writeOutput(const Framebuffer &image, const std::string &path, const CommandLine &cmd)
+{
+    if (cmd.toneMap.isIdentity() || fileExtension(path) == ".pfm")
+        return writeImage(image, path, cmd.pngLevel);
+    return writeImage(*toneMap(image, cmd.toneMap), path, cmd.pngLevel);
+}
+
+// insert a suffix before the file extension ("image.png", "_1" -> "image_1.png")
+std::string insertBeforeExtension(const std::string &path, const std::string &suffix)
+{
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + suffix;
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// scene fingerprint function (scene file contents plus the flags that change the image)
+uint64_t sceneFingerprint(const CommandLine &cmd)
+{
+    uint64_t hash = hashFile(cmd.scenePath);
+    return hashString(std::to_string(cmd.cameraTransform) + std::to_string(cmd.depthOfField) + std::to_string(samplesPerPixel), hash);
+}
+
+// tile file hash: the scene fingerprint plus the tiling, the same on the coordinator and its workers
+uint64_t tileFileHash(const CommandLine &cmd, const Camera &camera)
+{
+    return hashString(std::to_string(camera.imgWidth) + "x" + std::to_string(camera.imgHeight) + "/" + std::to_string(std::max(1, cmd.options.tileSize)),
+                      sceneFingerprint(cmd));
+}
+
+// worker process: render the listed tiles and leave one file per tile in the work directory
+int runWorker(CommandLine &cmd)
+{
+    Scene scene = loadScene(cmd);
+    RenderOptions options = cmd.options;
+    options.reportInterval = 0;
+
+    int tileCount = static_cast<int>(makeTiles(scene.camera.imgWidth, scene.camera.imgHeight, std::max(1, options.tileSize)).size());
+    options.tileMask = readTileList(cmd.workerTiles, tileCount);
+
+    std::atomic<bool> failed(false);
+    std::string dir = cmd.workerDir;
+    const uint64_t hash = tileFileHash(cmd, scene.camera);
+    options.onTile = [&failed, dir, hash](size_t index, const Tile &tile, const Framebuffer &image)
+    {
+        if (!writeTileFile(dir, static_cast<int>(index), tile, image, hash))
+            failed = true;
+    };
+
+    render(scene, scene.camera, options);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// coordinator process: spread the frame over local worker processes and merge their tiles
+int runCoordinator(CommandLine &cmd, const char *program)
+{
+    if (cmd.scenePath.empty())
+    {
+        std::cerr << "--workers needs --scene" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Workers pinned or bound the same way would all land on the same cores
+    if (cmd.options.pinThreads || cmd.options.numaLocal)
+    {
+        std::cerr << "--pin and --numa cannot be used with --workers" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string sceneOutput;
+    Camera camera = parseSceneCamera(cmd.scenePath, &sceneOutput);
+    if (cmd.width > 0)
+    {
+        camera.imgWidth = cmd.width;
+        camera.imgHeight = cmd.height;
+    }
+    std::vector<Tile> tiles = makeTiles(camera.imgWidth, camera.imgHeight, std::max(1, cmd.options.tileSize));
+
+    // Every worker gets an equal share of the cores unless --threads was given
+    int threads = cmd.options.threads;
+    if (!cmd.threadsGiven)
+        threads = std::max(1, static_cast<int>(allowedCpus().size()) / cmd.workers);
+
+    CoordinatorOptions coordinator;
+    coordinator.workers = cmd.workers;
+    coordinator.workDir = cmd.workerDir.empty() ? "./output.tiles" : cmd.workerDir;
+    coordinator.sceneHash = tileFileHash(cmd, camera);
+    coordinator.workerCommand.push_back(program);
+    coordinator.workerCommand.push_back("--scene");
+    coordinator.workerCommand.push_back(cmd.scenePath);
+    coordinator.workerCommand.push_back("--threads");
+    coordinator.workerCommand.push_back(std::to_string(threads));
+    coordinator.workerCommand.insert(coordinator.workerCommand.end(), cmd.renderArgs.begin(), cmd.renderArgs.end());
+
+    Framebuffer image(camera.imgWidth, camera.imgHeight);
+    bool complete = coordinateRender(coordinator, tiles, image);
+    if (!writeOutput(image, outputImagePath(cmd, sceneOutput), cmd))
+    {
+        std::cerr << "Writing the output failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!complete)
+    {
+        std::cerr << "Rendering incomplete, missing tiles are black" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Rendering completed!" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+// estimate mode: JSON on stdout, the scene loading chatter goes to stderr
+int runEstimate(CommandLine &cmd)
+{
+    std::streambuf *out = std::cout.rdbuf(std::cerr.rdbuf());
+    Scene scene = loadScene(cmd);
+    std::cout.rdbuf(out);
+
+    RenderEstimate estimate = estimateRender(scene, scene.camera, cmd.options.threads);
+    writeEstimateJson(std::cout, cmd.scenePath, estimate);
+    return EXIT_SUCCESS;
+}
+
+// set by SIGINT / SIGTERM (e.g. a preempted node) so the render stops at the next tile
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+// batch mode: render every scene of the list into <name>.ppm. Up to batchJobs scenes are
+// in flight, each with its share of the threads, so one scene is parsed while others
+// render; meshes and textures come from the process-wide asset cache.
+int runBatch(CommandLine &cmd)
+{
+    std::ifstream list(cmd.batchList);
+    if (!list)
+    {
+        std::cerr << "Cannot open batch list " << cmd.batchList << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> scenePaths;
+    std::string line;
+    while (std::getline(list, line))
+    {
+        if (!line.empty() && line[0] != '#')
+            scenePaths.push_back(line);
+    }
+
+    int jobs = std::min(cmd.batchJobs, static_cast<int>(scenePaths.size()));
+    int threads = cmd.options.threads;
+    if (!cmd.threadsGiven)
+        threads = std::max(1, static_cast<int>(allowedCpus().size()) / std::max(1, jobs));
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    std::atomic<size_t> nextScene(0);
+    std::atomic<int> failed(0);
+    std::mutex consoleMutex;
+    auto start = std::chrono::steady_clock::now();
+
+    // Streamed frames go out in list order while the following scenes render
+    std::unique_ptr<FrameStream> stream;
+    if (!cmd.streamPath.empty())
+    {
+        stream.reset(new FrameStream(cmd.streamPath, cmd.streamFormat, cmd.streamHeaders, cmd.toneMap, std::max(2, jobs)));
+        if (!stream->isOpen())
+            return EXIT_FAILURE;
+    }
+
+    auto slot = [&]()
+    {
+        size_t index;
+        // a broken stream ends the batch, its frames would only be dropped
+        while (!stopRequested && !(stream && stream->failed()) && (index = nextScene++) < scenePaths.size())
+        {
+            CommandLine sceneCmd = cmd;
+            sceneCmd.scenePath = scenePaths[index];
+
+            if (!std::ifstream(sceneCmd.scenePath))
+            {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "Cannot open scene " << sceneCmd.scenePath << ", skipped" << std::endl;
+                failed++;
+                if (stream)
+                    stream->skip(static_cast<uint32_t>(index));
+                continue;
+            }
+
+            auto sceneStart = std::chrono::steady_clock::now();
+            Scene scene;
+            if (!loadScene(sceneCmd, scene))
+            {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "Cannot load scene " << sceneCmd.scenePath << ", skipped" << std::endl;
+                failed++;
+                if (stream)
+                    stream->skip(static_cast<uint32_t>(index));
+                continue;
+            }
+
+            RenderOptions options = cmd.options;
+            options.threads = threads;
+            options.reportInterval = 0;
+            std::shared_ptr<Framebuffer> image = render(scene, scene.camera, options);
+
+            // the scene's output_file, or the scene file's name as a PPM
+            std::string outputPath = scene.outputFile;
+            if (outputPath.empty())
+            {
+                std::string name = sceneCmd.scenePath.substr(sceneCmd.scenePath.find_last_of('/') + 1);
+                outputPath = "./" + name.substr(0, name.find_last_of('.')) + ".ppm";
+            }
+            bool written;
+            if (stream)
+            {
+                // the I/O thread writes it, this slot moves on to the next scene
+                outputPath = "frame " + std::to_string(index);
+                written = stream->push(static_cast<uint32_t>(index), image) && image;
+            }
+            else
+            {
+                written = image && writeOutput(*image, outputPath, cmd);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sceneStart).count();
+
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            if (!written)
+            {
+                std::cerr << "Rendering " << sceneCmd.scenePath << " failed" << std::endl;
+                failed++;
+                continue;
+            }
+            std::cout << "Batch: " << sceneCmd.scenePath << " -> " << outputPath << " (" << seconds << " s)" << std::endl;
+        }
+    };
+
+    std::vector<std::thread> slots;
+    for (int j = 0; j < jobs; ++j)
+        slots.emplace_back(slot);
+    for (std::thread &t : slots)
+        t.join();
+    if (stream && !stream->finish())
+        failed++;
+    // scenes never started (stopped, or the stream broke) are not completed either
+    failed += static_cast<int>(scenePaths.size() - std::min(nextScene.load(), scenePaths.size()));
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Batch completed: " << scenePaths.size() - failed << " of " << scenePaths.size() << " scenes in " << seconds
+              << " s (" << jobs << " at a time, " << threads << " threads each, " << assetCache().meshCount() << " meshes, "
+              << assetCache().textureCount() << " textures loaded, " << assetCache().peakTextureBytes() / 1e6 << " MB of textures at most)" << std::endl;
+
+    return failed || stopRequested ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// server mode: keep scenes resident and render requests from the socket until shutdown
+int runServer(CommandLine &cmd)
+{
+    CommandLine sceneCmd = cmd;
+    auto loader = [sceneCmd](const std::string &path) -> std::shared_ptr<Scene>
+    {
+        // a broken scene or mesh is reported to the client, the server keeps running
+        CommandLine loadCmd = sceneCmd;
+        loadCmd.scenePath = path;
+        std::shared_ptr<Scene> scene(new Scene());
+        if (!loadScene(loadCmd, *scene))
+        {
+            std::cerr << "Cannot load scene " << path << std::endl;
+            return nullptr;
+        }
+        std::cout << "Loaded " << path << ", " << assetCache().textureBytes() / 1e6 << " MB of textures resident" << std::endl;
+        return scene;
+    };
+
+    RenderServer server(cmd.serveSocket, loader, cmd.options);
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::thread watcher([&server]()
+                        {
+                            while (!stopRequested)
+                                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                            server.stop(); });
+
+    bool ok = server.run();
+    stopRequested = 1;
+    watcher.join();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// client mode: send one render request to a server and save the streamed image
+int runClient(CommandLine &cmd)
+{
+    if (cmd.requestLine.empty())
+    {
+        std::cerr << "--connect needs --request" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Anything but a render is a plain request with a one line reply
+    if (cmd.requestLine.compare(0, 7, "render ") != 0)
+    {
+        int fd = connectUnixSocket(cmd.connectSocket);
+        std::string reply;
+        bool ok = fd >= 0 && sendLine(fd, cmd.requestLine) && receiveLine(fd, reply);
+        if (fd >= 0)
+            close(fd);
+        std::cout << (ok ? reply : "error no reply") << std::endl;
+        return ok && reply.compare(0, 2, "ok") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::shared_ptr<Framebuffer> image;
+    RenderStatus status;
+    if (!renderRemote(cmd.connectSocket, cmd.requestLine, image, status) || status != RenderStatus::COMPLETED)
+        return EXIT_FAILURE;
+
+    writeOutput(*image, outputImagePath(cmd, ""), cmd);
+    std::cout << "Rendering completed!" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+//  main function
+int main(int argc, char **argv)
+{
+    CommandLine cmd = parseArguments(argc, argv);
+
+    // Frames own stdout when streamed there, the console output moves to stderr
+    if (!cmd.streamPath.empty())
+    {
+        if (cmd.streamPath == "-")
+            std::cout.rdbuf(std::cerr.rdbuf());
+        std::signal(SIGPIPE, SIG_IGN);
+    }
+
+    if (!cmd.workerTiles.empty())
+        return runWorker(cmd);
+    if (cmd.workers > 0)
+        return runCoordinator(cmd, argv[0]);
+    if (cmd.estimate)
+        return runEstimate(cmd);
+    if (!cmd.batchList.empty())
+        return runBatch(cmd);
+    if (!cmd.serveSocket.empty())
+        return runServer(cmd);
+    if (!cmd.connectSocket.empty())
+        return runClient(cmd);
+    if (!cmd.untileInput.empty())
+        return convertTiledToP6(cmd.untileInput, cmd.untileOutput) ? 0 : EXIT_FAILURE;
+    if (!cmd.convertMeshInput.empty())
+    {
+        MeshArrays mesh = loadMesh(cmd.convertMeshInput);
+        return mesh.isLoaded() && writeMeshFile(mesh, cmd.convertMeshOutput) ? 0 : EXIT_FAILURE;
+    }
+    if (!cmd.toneMapInput.empty())
+    {
+        // Tone map a saved render again (e.g. another exposure) without rendering
+        std::shared_ptr<Framebuffer> hdr = readPFM(cmd.toneMapInput);
+        return hdr && writeOutput(*hdr, outputImagePath(cmd, ""), cmd) ? 0 : EXIT_FAILURE;
+    }
+
+    Scene scene = loadScene(cmd);
+    RenderOptions options = cmd.options;
+
+    std::vector<Camera> cameras = makeViews(cmd.views, scene.camera);
+    if (cameras.empty())
+    {
+        std::cerr << "Unknown --views " << cmd.views << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // size of every rendered view (a cube map's faces are square, whatever the scene's frame)
+    const int width = cameras[0].imgWidth;
+    const int height = cameras[0].imgHeight;
+    if (cameras.size() > 1 && !cmd.checkpointPath.empty())
+    {
+        std::cerr << "--checkpoint works on single-view renders only" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (cmd.progressive && (cameras.size() > 1 || !cmd.checkpointPath.empty()))
+    {
+        std::cerr << "--progressive works on single-view renders without --checkpoint" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Crop window, optionally rendered over an existing image of the same size
+    options.crop = cropWindow(cmd, cameras[0]);
+    if (options.crop.x0 < options.crop.x1 && !cmd.checkpointPath.empty())
+    {
+        std::cerr << "--checkpoint works on full-frame renders only" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!cmd.compositePath.empty())
+    {
+        // the base must be linear like the new pixels: a PFM (e.g. the previous --hdr), or an
+        // 8-bit PPM only when the output is not tone mapped
+        bool linear = fileExtension(cmd.compositePath) == ".pfm";
+        if (!linear && !cmd.toneMap.isIdentity())
+        {
+            std::cerr << "--composite with a tone map needs the linear base as a PFM (--hdr of the previous render)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        options.target = linear ? readPFM(cmd.compositePath) : readPPM(cmd.compositePath);
+        if (!options.target || options.target->width != width || options.target->height != height)
+        {
+            std::cerr << "--composite needs a " << width << "x" << height << " PPM or PFM image" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Out-of-core: quantize the tiles into the mapped output file as they finish
+    std::string outputPath = outputImagePath(cmd, scene.outputFile);
+    std::unique_ptr<MappedImage> mapped;
+    if (cmd.outOfCore && !cmd.streamPath.empty())
+    {
+        std::cerr << "--out-of-core and --stream both replace the output image, pick one" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (cmd.outOfCore)
+    {
+        std::string extension = fileExtension(outputPath);
+        if (extension != ".ppm" && extension != ".rtiles")
+        {
+            std::cerr << "--out-of-core writes .ppm or .rtiles files only" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (cameras.size() > 1 || cmd.progressive || !cmd.checkpointPath.empty() || options.target || !cmd.hdrPath.empty())
+        {
+            std::cerr << "--out-of-core works on single-view renders without --progressive, --checkpoint, --composite or --hdr" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Autotuning: reuse the cached winner for this scene and host, otherwise probe
+    if (cmd.autotune)
+    {
+        uint64_t sceneHash = sceneFingerprint(cmd);
+        TuneConfig config;
+        if (cmd.retune || !loadTuneConfig(cmd.autotuneCache, sceneHash, config))
+        {
+            config = autotune(scene, scene.camera);
+            saveTuneConfig(cmd.autotuneCache, sceneHash, config);
+        }
+        options.threads = config.threads;
+        options.tileSize = config.tileSize;
+        options.pinThreads = config.pinThreads;
+        options.numaLocal = config.numaLocal;
+        std::cout << "Autotuned: threads=" << config.threads << ", tile=" << config.tileSize << ", pin=" << config.pinThreads
+                  << ", numa=" << config.numaLocal << " (" << config.raysPerSecond / 1e6 << " Mrays/s)" << std::endl;
+    }
+
+    // Live view: render straight into a shared memory segment (checkpointed tiles are restored into it too)
+    std::unique_ptr<SharedFramebuffer> shared;
+    if (!cmd.sharedMemory.empty())
+    {
+        if (cameras.size() > 1 || cmd.outOfCore || options.target)
+        {
+            std::cerr << "--shm works on single-view renders without --out-of-core or --composite" << std::endl;
+            return EXIT_FAILURE;
+        }
+        shared.reset(new SharedFramebuffer(cmd.sharedMemory, width, height, std::max(1, options.tileSize)));
+        if (!shared->isOpen())
+            return EXIT_FAILURE;
+        options.target = shared->image();
+    }
+
+    // Checkpointing: restore finished tiles and save new ones as they complete
+    std::unique_ptr<CheckpointWriter> checkpoint;
+    if (!cmd.checkpointPath.empty())
+    {
+        const int tileSize = std::max(1, options.tileSize);
+        std::vector<Tile> tiles = makeTiles(width, height, tileSize);
+        CheckpointHeader header = makeCheckpointHeader(width, height, tileSize, sceneFingerprint(cmd));
+
+        if (!options.target)
+            options.target.reset(new Framebuffer(width, height));
+        bool resumed = false;
+        if (cmd.resume)
+        {
+            std::vector<char> done;
+            std::vector<uint32_t> samples;
+            resumed = loadCheckpoint(cmd.checkpointPath, header, tiles, *options.target, done, samples);
+            if (resumed)
+            {
+                options.tileMask.assign(tiles.size(), 1);
+                int restored = 0;
+                for (size_t i = 0; i < tiles.size(); ++i)
+                {
+                    if (done[i] && samples[i] >= static_cast<uint32_t>(samplesPerPixel))
+                    {
+                        options.tileMask[i] = 0;
+                        restored++;
+                    }
+                }
+                std::cout << "Resuming: " << restored << " of " << tiles.size() << " tiles restored from " << cmd.checkpointPath << std::endl;
+            }
+            else
+            {
+                std::cerr << "No matching checkpoint in " << cmd.checkpointPath << ", starting from scratch" << std::endl;
+            }
+        }
+
+        checkpoint.reset(new CheckpointWriter(cmd.checkpointPath, header, resumed, cmd.checkpointInterval));
+        if (!checkpoint->isOpen())
+            return EXIT_FAILURE;
+        CheckpointWriter *writer = checkpoint.get();
+        options.onTile = [writer](size_t index, const Tile &tile, const Framebuffer &image)
+        {
+            writer->add(index, tile, image, samplesPerPixel);
+        };
+    }
+
+    if (shared)
+    {
+        SharedFramebuffer *segment = shared.get();
+        std::function<void(size_t, const Tile &, const Framebuffer &)> previous = options.onTile;
+        options.onTile = [segment, previous](size_t index, const Tile &tile, const Framebuffer &image)
+        {
+            if (previous)
+                previous(index, tile, image);
+            segment->tileDone(index);
+        };
+        segment->beginFrame();
+    }
+
+    if (cmd.outOfCore)
+    {
+        // after autotuning, which may change the tile size of the tiled layout
+        MappedLayout layout = fileExtension(outputPath) == ".rtiles" ? MappedLayout::TILES : MappedLayout::SCANLINES;
+        mapped.reset(new MappedImage(outputPath, width, height, std::max(1, options.tileSize), layout));
+        if (!mapped->isOpen())
+            return EXIT_FAILURE;
+        MappedImage *output = mapped.get();
+        ToneMapSettings settings = cmd.toneMap;
+        options.onTileBuffer = [output, settings](size_t index, const Tile &tile, const Framebuffer &tilePixels)
+        {
+            if (settings.isIdentity())
+                output->writeTile(index, tile, tilePixels);
+            else
+                output->writeTile(index, tile, *toneMap(tilePixels, settings));
+        };
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    RenderResult result;
+    if (cmd.progressive)
+    {
+        // Refresh the preview after every level; the rename keeps viewers from reading half a file
+        auto start = std::chrono::steady_clock::now();
+        std::string previewPath = cmd.previewPath;
+        options.reportInterval = 0;
+        result = renderProgressive(
+            scene, scene.camera, options, [&start, &cmd, previewPath](int step, const Framebuffer &image)
+            {
+                std::string tmpPath = insertBeforeExtension(previewPath, ".tmp");
+                if (writeOutput(image, tmpPath, cmd))
+                    std::rename(tmpPath.c_str(), previewPath.c_str());
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::cout << "Preview 1/" << step << " written to " << previewPath << " after " << seconds << " s" << std::endl; },
+            []()
+            { return stopRequested != 0; });
+    }
+    else
+    {
+        // Render the scene to an image (one per view)
+        std::shared_ptr<RenderJob> job = renderViewsAsync(scene, cameras, options);
+        std::shared_future<RenderResult> future = job->result();
+        while (future.wait_for(std::chrono::milliseconds(200)) != std::future_status::ready)
+        {
+            if (stopRequested)
+                job->cancel();
+        }
+        result = future.get();
+    }
+
+    if (checkpoint)
+        checkpoint->stop();
+    bool written = true;
+    if (mapped)
+        written = mapped->close();
+    if (shared)
+        shared->endFrame();
+
+    if (result.status != RenderStatus::COMPLETED)
+    {
+        std::cerr << "Rendering interrupted";
+        if (checkpoint)
+            std::cerr << ", finished tiles are saved in " << cmd.checkpointPath << " (continue with --resume)";
+        std::cerr << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (mapped)
+    {
+        if (written)
+            std::cout << "Image written to " << outputPath << std::endl;
+    }
+    else if (!cmd.streamPath.empty())
+    {
+        // one frame per view
+        FrameStream stream(cmd.streamPath, cmd.streamFormat, cmd.streamHeaders, cmd.toneMap);
+        for (size_t v = 0; v < result.views.size(); ++v)
+            stream.push(static_cast<uint32_t>(v), result.views[v]);
+        if (!stream.finish())
+            return EXIT_FAILURE;
+    }
+    else if (cameras.size() == 1)
+    {
+        written = writeOutput(*result.image, outputPath, cmd);
+        if (!cmd.hdrPath.empty())
+            written = writePFM(*result.image, cmd.hdrPath) && written;
+    }
+    else
+    {
+        for (size_t v = 0; v < result.views.size(); ++v)
+        {
+            std::string suffix = "_" + std::to_string(v);
+            written = writeOutput(*result.views[v], insertBeforeExtension(outputPath, suffix), cmd) && written;
+            if (!cmd.hdrPath.empty())
+                written = writePFM(*result.views[v], insertBeforeExtension(cmd.hdrPath, suffix)) && written;
+        }
+    }
+    if (!written)
+    {
+        std::cerr << "Writing the output failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // console output
+    std::cout << "Rendering completed!" << std::endl;
 
     return 0;
 }